@@ -0,0 +1,321 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "camera.hpp"
+#include "imagesource.hpp"
+#include "refine.hpp"
+
+namespace po = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+/*
+ * Tries every combination of the point flags that only trade detection
+ * speed against robustness on a sample of images, and writes the
+ * calibration yml with the fastest combination that still detects the
+ * board in enough images and agrees with the other combinations on where
+ * the corners are. Flags in the input yml that change what is detected
+ * (grid type, LARGER, MARKER) are kept as they are.
+ */
+
+struct CmdArgs {
+	std::string conf;
+	std::string impath;
+	std::string out;
+	int sample = 24;
+	double targetRate = 0.9;
+	double maxDisagreement = 0.5;
+};
+
+struct Candidate {
+	std::vector<std::string> flags;
+	std::vector<vecp2f> corners; // per image, empty if not found
+	std::vector<double> ms;
+	int found = 0;
+	double meanMs = 0.0;
+	double disagreement = 0.0; // mean corner distance to the consensus, pixels
+};
+
+bool read_cmd_line(int argc, char *argv[], CmdArgs &args)
+{
+	po::options_description opt("Autotune options");
+
+	opt.add_options()
+		("help,h", "produce help message")
+		("conf,c", po::value<std::string>(&args.conf)->required(), "configuration file to tune")
+		("path,p", po::value<std::string>(&args.impath)->required(), "path to images")
+		("out,o", po::value<std::string>(&args.out)->required(), "tuned configuration file")
+		("sample,n", po::value<int>(&args.sample)->default_value(24),
+              "images picked evenly from the directory")
+		("target-rate,r", po::value<double>(&args.targetRate)->default_value(0.9),
+              "fraction of the sampled images the board must be found in")
+		("max-disagreement,d", po::value<double>(&args.maxDisagreement)->default_value(0.5),
+              "largest mean corner distance in pixels to the consensus of all combinations")
+		;
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(opt).run(), vm);
+
+	if(vm.count("help")){
+		std::cout << opt << std::endl;
+		return false;
+	}
+
+	po::notify(vm);
+
+	if(args.sample < 1 || args.targetRate < 0.0 || args.targetRate > 1.0){
+		throw std::runtime_error("--sample must be positive and --target-rate in [0, 1]!");
+	}
+
+	return true;
+}
+
+static std::vector<std::string> tunableFlags(const std::string &pointType)
+{
+	if(pointType == "CHESS"){
+		return {"cv::CALIB_CB_ADAPTIVE_THRESH", "cv::CALIB_CB_FILTER_QUADS",
+			"cv::CALIB_CB_FAST_CHECK", "cv::CALIB_CB_NORMALIZE_IMAGE"};
+	}
+	else if(pointType == "SB_CHESS"){
+		return {"cv::CALIB_CB_NORMALIZE_IMAGE", "cv::CALIB_CB_EXHAUSTIVE",
+			"cv::CALIB_CB_ACCURACY"};
+	}
+	else if(pointType == "CIRCLE"){
+		return {"cv::CALIB_CB_CLUSTERING"};
+	}
+	throw std::runtime_error(pointType + " is not a valid point type!\n");
+}
+
+static std::vector<cv::Mat> loadSample(const std::string &dir, int sample)
+{
+	const std::vector<std::string> files = FileSource::listDirectory(dir);
+	const size_t n = std::min(files.size(), static_cast<size_t>(sample));
+
+	std::vector<cv::Mat> images;
+	for(size_t i = 0; i < n; i++){
+		const std::string &file = files[i * files.size() / n];
+		cv::Mat image = cv::imread(file, cv::IMREAD_GRAYSCALE);
+		if(image.empty()){
+			std::cout << "skipping " << file << ", not an image\n";
+			continue;
+		}
+		images.push_back(image);
+	}
+
+	if(images.empty()){
+		throw std::runtime_error("No images to tune on in " + dir + "\n");
+	}
+	return images;
+}
+
+static void detect(const YAML::Node &base, const std::vector<cv::Mat> &images, Candidate &cand)
+{
+	YAML::Node node = YAML::Clone(base);
+	node["PointFlags"] = cand.flags;
+
+	cand.corners.assign(images.size(), vecp2f());
+	cand.ms.assign(images.size(), 0.0);
+
+	// built once, findPoints and refine are safe to share between threads
+	const CalibrationConfig conf(node);
+	const CornerRefiner refiner(node["SubPix"], conf);
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(images.size())), [&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			auto start = clk::now();
+			const bool found = conf.findPoints(images[i], cand.corners[i]);
+			cand.ms[i] = std::chrono::duration<double, std::milli>(clk::now() - start).count();
+
+			if(found){
+				refiner.refine(images[i], cand.corners[i]);
+			}
+			else{
+				cand.corners[i].clear();
+			}
+		}
+	});
+
+	cand.found = static_cast<int>(std::count_if(cand.corners.begin(), cand.corners.end(),
+				[](const vecp2f &c){return !c.empty();}));
+	cand.meanMs = 0.0;
+	for(double ms : cand.ms){
+		cand.meanMs += ms;
+	}
+	cand.meanMs /= images.size();
+}
+
+static double meanDistance(const vecp2f &a, const vecp2f &b)
+{
+	double sum = 0.0;
+	for(size_t k = 0; k < a.size(); k++){
+		sum += cv::norm(a[k] - b[k]);
+	}
+	return sum / a.size();
+}
+
+// per image, the per-corner median over every combination that found the
+// board is the consensus each combination is measured against
+static void measureAgreement(std::vector<Candidate> &cands, size_t nImages)
+{
+	std::vector<double> sums(cands.size(), 0.0);
+
+	for(size_t i = 0; i < nImages; i++){
+		std::vector<vecp2f> aligned;
+		std::vector<size_t> owners;
+
+		for(size_t c = 0; c < cands.size(); c++){
+			vecp2f corners = cands[c].corners[i];
+			if(corners.empty()){
+				continue;
+			}
+			if(!aligned.empty() && corners.size() == aligned[0].size()){
+				// a symmetric board can be reported starting from either end
+				vecp2f reversed(corners.rbegin(), corners.rend());
+				if(meanDistance(reversed, aligned[0]) < meanDistance(corners, aligned[0])){
+					corners = reversed;
+				}
+			}
+			if(aligned.empty() || corners.size() == aligned[0].size()){
+				aligned.push_back(corners);
+				owners.push_back(c);
+			}
+		}
+
+		if(aligned.empty()){
+			continue;
+		}
+
+		vecp2f consensus(aligned[0].size());
+		std::vector<float> xs(aligned.size()), ys(aligned.size());
+		for(size_t k = 0; k < consensus.size(); k++){
+			for(size_t a = 0; a < aligned.size(); a++){
+				xs[a] = aligned[a][k].x;
+				ys[a] = aligned[a][k].y;
+			}
+			std::nth_element(xs.begin(), xs.begin() + xs.size() / 2, xs.end());
+			std::nth_element(ys.begin(), ys.begin() + ys.size() / 2, ys.end());
+			consensus[k] = cv::Point2f(xs[xs.size() / 2], ys[ys.size() / 2]);
+		}
+
+		for(size_t a = 0; a < aligned.size(); a++){
+			sums[owners[a]] += meanDistance(aligned[a], consensus);
+		}
+	}
+
+	for(size_t c = 0; c < cands.size(); c++){
+		cands[c].disagreement = cands[c].found ? sums[c] / cands[c].found : 0.0;
+	}
+}
+
+static std::string joinFlags(const std::vector<std::string> &flags)
+{
+	const std::string prefix = "cv::CALIB_CB_";
+
+	std::string joined;
+	for(const auto &f : flags){
+		joined += (joined.empty() ? "" : " | ")
+			+ (f.rfind(prefix, 0) == 0 ? f.substr(prefix.size()) : f);
+	}
+	return joined.empty() ? "none" : joined;
+}
+
+int main(int argc, char *argv[])
+{
+	try{
+		CmdArgs args;
+
+		if(!read_cmd_line(argc, argv, args)){
+			return 0;
+		}
+
+		const YAML::Node base = YAML::LoadFile(args.conf);
+		const std::vector<std::string> tunable = tunableFlags(base["PointType"].as<std::string>());
+
+		// flags of the input that are not tuned are kept in every combination
+		std::vector<std::string> fixed;
+		for(const auto &f : base["PointFlags"].as<std::vector<std::string>>()){
+			if(std::find(tunable.begin(), tunable.end(), f) == tunable.end()){
+				fixed.push_back(f);
+			}
+		}
+
+		const std::vector<cv::Mat> images = loadSample(args.impath, args.sample);
+		std::cout << "tuning on " << images.size() << " images, "
+			<< (1 << tunable.size()) << " combinations" << std::endl;
+
+		std::vector<Candidate> cands(size_t(1) << tunable.size());
+		for(size_t mask = 0; mask < cands.size(); mask++){
+			cands[mask].flags = fixed;
+			for(size_t b = 0; b < tunable.size(); b++){
+				if(mask & (size_t(1) << b)){
+					cands[mask].flags.push_back(tunable[b]);
+				}
+			}
+			// one combination at a time, so every timing sees the same load
+			detect(base, images, cands[mask]);
+		}
+
+		measureAgreement(cands, images.size());
+
+		const int needed = static_cast<int>(std::ceil(args.targetRate * images.size()));
+		const Candidate *best = nullptr;
+		const Candidate *mostFound = &cands[0];
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "found\tms/img\tdisagree\tflags\n";
+		for(const auto &c : cands){
+			std::cout << c.found << "/" << images.size() << "\t" << c.meanMs << "\t"
+				<< c.disagreement << "\t\t" << joinFlags(c.flags) << "\n";
+
+			if(c.found > mostFound->found ||
+					(c.found == mostFound->found && c.meanMs < mostFound->meanMs)){
+				mostFound = &c;
+			}
+			if(c.found >= needed && c.disagreement <= args.maxDisagreement &&
+					(!best || c.meanMs < best->meanMs)){
+				best = &c;
+			}
+		}
+
+		if(!best){
+			std::cout << "No combination found the board in " << needed << " images, "
+				"using the one with the most detections" << std::endl;
+			best = mostFound;
+		}
+
+		std::cout << "selected " << joinFlags(best->flags) << ", "
+			<< best->found << "/" << images.size() << " found, "
+			<< best->meanMs << " ms/img" << std::endl;
+
+		YAML::Node tuned = YAML::Clone(base);
+		tuned["PointFlags"] = best->flags;
+
+		YAML::Emitter emitter;
+		emitter << tuned;
+
+		std::ofstream out(args.out);
+		if(!out.is_open()){
+			throw std::runtime_error("Unable to write " + args.out + "\n");
+		}
+		out << emitter.c_str() << std::endl;
+
+	}
+	catch(std::exception const & e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
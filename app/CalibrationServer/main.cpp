@@ -0,0 +1,353 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "camera.hpp"
+#include "session.hpp"
+#include "imagesource.hpp"
+
+namespace po = boost::program_options;
+using clk = std::chrono::steady_clock;
+
+/*
+ * Calibration daemon, keeps config, detections and camera warm between
+ * requests. Line based protocol over a unix domain socket, one reply line
+ * per command:
+ *
+ *   ADD <path>            detect in image file
+ *   FRAME <width> <height> followed by width*height raw 8 bit gray bytes,
+ *                         sides above --max-frame-side close the connection
+ *   SOLVE                 (re)calibrate, warm started after the first solve
+ *   STATS                 current model and view counts
+ *   WRITE <dir>           write <dir>/<name>.yml, log.csv and summary.json
+ *   QUIT                  close this connection
+ *   SHUTDOWN              stop the server
+ */
+
+bool read_cmd_line(int argc, char *argv[],
+		std::string &conf, std::string &socketPath, std::string &name,
+		double &sensorWidth, double &sensorHeight, int &maxFrameSide)
+{
+	po::options_description opt("CalibrationServer options");
+
+	opt.add_options()
+		("help,h", "produce help message")
+		("conf,c", po::value<std::string>(&conf)->required(), "configuration file")
+		("socket,s", po::value<std::string>(&socketPath)->required(),
+              "path of the unix domain socket to listen on")
+		("name,n", po::value<std::string>(&name)->required(),
+              "name of camera will result in <dir>/<name>.yml on WRITE")
+		("sensor-width", po::value<double>(&sensorWidth)->default_value(3.200),
+              "sensor width in mm")
+		("sensor-height", po::value<double>(&sensorHeight)->default_value(2.400),
+              "sensor height in mm")
+		("max-frame-side", po::value<int>(&maxFrameSide)->default_value(16384),
+              "largest FRAME width or height accepted, bounds what a client can make the server allocate")
+		;
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(opt).run(), vm);
+
+	if(vm.count("help")){
+		std::cout << opt << std::endl;
+		return false;
+	}
+
+	po::notify(vm);
+
+	if(maxFrameSide < 1){
+		throw std::runtime_error("--max-frame-side must be positive!");
+	}
+	return true;
+}
+
+// buffered reading from one connected client
+class Connection {
+	public:
+		explicit Connection(int fd): fd_(fd), pos_(0) {}
+		~Connection(){ close(fd_); }
+
+		Connection(const Connection &other) = delete;
+		Connection &operator=(const Connection &other) = delete;
+
+		// commands are short, a client that sends more than maxLine bytes
+		// without a newline gets an ERR and is dropped instead of buffered
+		static constexpr size_t maxLine = 4096;
+
+		bool readLine(std::string &line)
+		{
+			while(true){
+				for(size_t i = pos_; i < buf_.size() && i - pos_ <= maxLine; i++){
+					if(buf_[i] == '\n'){
+						line.assign(buf_.begin() + pos_, buf_.begin() + i);
+						if(!line.empty() && line.back() == '\r'){
+							line.pop_back();
+						}
+						pos_ = i + 1;
+						return true;
+					}
+				}
+				if(buf_.size() - pos_ > maxLine){
+					send("ERR line longer than " + std::to_string(maxLine) + " bytes");
+					return false;
+				}
+				if(!fill()){
+					return false;
+				}
+			}
+		}
+
+		// buffered bytes first, the rest is received straight into dst
+		bool readExact(unsigned char *dst, size_t n)
+		{
+			size_t buffered = std::min(n, buf_.size() - pos_);
+			std::memcpy(dst, buf_.data() + pos_, buffered);
+			pos_ += buffered;
+
+			size_t got = buffered;
+			while(got < n){
+				ssize_t r = recv(fd_, dst + got, n - got, 0);
+				if(r <= 0){
+					return false;
+				}
+				got += r;
+			}
+			return true;
+		}
+
+		bool send(const std::string &msg)
+		{
+			std::string out = msg + "\n";
+			size_t sent = 0;
+			while(sent < out.size()){
+				ssize_t r = ::send(fd_, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+				if(r <= 0){
+					return false;
+				}
+				sent += r;
+			}
+			return true;
+		}
+
+	private:
+
+		bool fill()
+		{
+			buf_.erase(buf_.begin(), buf_.begin() + pos_);
+			pos_ = 0;
+
+			char chunk[4096];
+			ssize_t r = recv(fd_, chunk, sizeof(chunk), 0);
+			if(r <= 0){
+				return false;
+			}
+			buf_.insert(buf_.end(), chunk, chunk + r);
+			return true;
+		}
+
+		int fd_;
+		std::vector<char> buf_;
+		size_t pos_;
+};
+
+static double msSince(clk::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(clk::now() - start).count();
+}
+
+static std::string addReply(const CalibrationSession &session, bool found, double ms)
+{
+	std::ostringstream os;
+	os << "OK " << (found ? "found" : "missed")
+		<< " views " << session.views() << " ms " << ms;
+	return os.str();
+}
+
+// returns false when the connection should be closed
+// frame and bytes are buffers kept across commands
+static bool handle(CalibrationSession &session, Connection &conn,
+		const std::string &line, cv::Mat &frame, std::vector<uchar> &bytes,
+		int maxFrameSide, bool &shutdown)
+{
+	std::istringstream is(line);
+	std::string cmd;
+	is >> cmd;
+
+	auto start = clk::now();
+
+	try{
+		if(cmd == "ADD"){
+			std::string path;
+			std::getline(is >> std::ws, path);
+
+			if(!readFile(path, bytes)
+					|| cv::imdecode(bytes, cv::IMREAD_GRAYSCALE, &frame).empty()){
+				return conn.send("ERR unable to read " + path);
+			}
+			bool found = session.addImage(frame);
+			return conn.send(addReply(session, found, msSince(start)));
+		}
+		else if(cmd == "FRAME"){
+			int width = 0, height = 0;
+			is >> width >> height;
+			if(!is || width <= 0 || height <= 0){
+				return conn.send("ERR usage FRAME <width> <height>");
+			}
+			if(width > maxFrameSide || height > maxFrameSide){
+				// the payload that follows can't be skipped safely, drop the client
+				conn.send("ERR frame larger than " + std::to_string(maxFrameSide) + " pixels per side");
+				return false;
+			}
+
+			// reuses the buffer as long as the frame size is unchanged
+			frame.create(height, width, CV_8UC1);
+			if(!conn.readExact(frame.data, frame.total())){
+				return false;
+			}
+			bool found = session.addImage(frame);
+			return conn.send(addReply(session, found, msSince(start)));
+		}
+		else if(cmd == "SOLVE"){
+			double rms = session.solve();
+			std::ostringstream os;
+			os << "OK rms " << rms << " views " << session.views()
+				<< " ms " << msSince(start);
+			return conn.send(os.str());
+		}
+		else if(cmd == "STATS"){
+			std::ostringstream os;
+			os << "OK views " << session.views()
+				<< " attempts " << session.attempts();
+			if(session.solved()){
+				const cv::Mat &K = session.camera().getIntrinsics();
+				os << " rms " << session.rms()
+					<< " fx " << K.at<double>(0,0)
+					<< " fy " << K.at<double>(1,1)
+					<< " cx " << K.at<double>(0,2)
+					<< " cy " << K.at<double>(1,2);
+			}
+			return conn.send(os.str());
+		}
+		else if(cmd == "WRITE"){
+			std::string dir;
+			std::getline(is >> std::ws, dir);
+			if(!session.write(dir)){
+				return conn.send("ERR unable to write to " + dir);
+			}
+			return conn.send("OK");
+		}
+		else if(cmd == "QUIT"){
+			conn.send("OK");
+			return false;
+		}
+		else if(cmd == "SHUTDOWN"){
+			conn.send("OK");
+			shutdown = true;
+			return false;
+		}
+		else{
+			return conn.send("ERR unknown command " + cmd);
+		}
+	}
+	catch(std::exception const &e){
+		std::string msg(e.what());
+		while(!msg.empty() && msg.back() == '\n'){
+			msg.pop_back();
+		}
+		return conn.send("ERR " + msg);
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	std::string conf, socketPath, name;
+	double sensorWidth = 0.0, sensorHeight = 0.0;
+	int maxFrameSide = 0;
+
+	try{
+		if(!read_cmd_line(argc, argv, conf, socketPath, name,
+					sensorWidth, sensorHeight, maxFrameSide)){
+			return 0;
+		}
+
+		YAML::Node ymlConf = YAML::LoadFile(conf);
+		CalibrationSession session(ymlConf, name);
+
+		session.camera().setSensorWidth(sensorWidth);
+		session.camera().setSensorHeight(sensorHeight);
+
+		sockaddr_un addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+
+		if(socketPath.size() >= sizeof(addr.sun_path)){
+			throw std::runtime_error("Socket path too long: " + socketPath);
+		}
+		std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+		int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(listenFd < 0){
+			throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+		}
+
+		unlink(socketPath.c_str());
+		if(bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+				listen(listenFd, 4) < 0){
+			close(listenFd);
+			throw std::runtime_error(std::string("bind/listen: ") + std::strerror(errno));
+		}
+
+		std::cout << "Listening on " << socketPath << std::endl;
+
+		cv::Mat frame;
+		std::vector<uchar> bytes;
+		bool shutdown = false;
+
+		while(!shutdown){
+			int clientFd = accept(listenFd, nullptr, nullptr);
+			if(clientFd < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				break;
+			}
+
+			Connection conn(clientFd);
+			std::string line;
+			while(conn.readLine(line)){
+				if(line.empty()){
+					continue;
+				}
+				if(!handle(session, conn, line, frame, bytes, maxFrameSide, shutdown)){
+					break;
+				}
+			}
+		}
+
+		close(listenFd);
+		unlink(socketPath.c_str());
+	}
+	catch(std::exception const & e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
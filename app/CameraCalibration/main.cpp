@@ -12,27 +12,100 @@
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <memory>
+#include <chrono>
+#include <cmath>
 
 #include "utils.hpp"
 #include "camera.hpp"
+#include "coverage.hpp"
+#include "imagesource.hpp"
+#include "residuals.hpp"
+#include "prefilter.hpp"
+#include "sensormode.hpp"
+#include "refine.hpp"
+#include "thumbnails.hpp"
+#include "detections.hpp"
 
 namespace fs = std::filesystem;
 namespace po = boost::program_options;
-
-
-bool read_cmd_line(int argc, char *argv[],
-		std::string &impath, std::string &conf, std::string &out, std::string &name)
+using clk = std::chrono::steady_clock;
+
+struct CmdArgs {
+	std::string impath;
+	std::string manifest;
+	std::string video;
+	std::string stream;
+	std::string shm;
+	bool rawStdin = false;
+	int width = 0;
+	int height = 0;
+	std::string conf;
+	std::string out;
+	std::string name;
+	std::string sensor;
+	double sensorWidth = 0.0;
+	double sensorHeight = 0.0;
+	bool batch = false;
+	bool compareInit = false;
+	bool thumbnails = false;
+	int thumbSize = 320;
+	int prefetchThreads = 2;
+	size_t prefetchMb = 512;
+	bool sharded = false;
+	int shardIndex = 0;
+	int shardCount = 1;
+	std::vector<std::string> merge;
+};
+
+bool read_cmd_line(int argc, char *argv[], CmdArgs &args)
 {
 	po::options_description opt("CameraCalibration options");
 
 	opt.add_options()
 		("help,h", "produce help message")
-		("path,p", po::value<std::string>(&impath)->required(), "path to images")
-		("conf,c", po::value<std::string>(&conf)->required(), "configuration file")
-		("name,n", po::value<std::string>(&name)->required(), 
+		("path,p", po::value<std::string>(&args.impath), "path to images")
+		("manifest,m", po::value<std::string>(&args.manifest),
+              "file listing one image path per line, processed in that order")
+		("video,v", po::value<std::string>(&args.video), "path to a video file")
+		("stream,s", po::value<std::string>(&args.stream),
+              "capture device index or stream url")
+		("raw-stdin", po::bool_switch(&args.rawStdin),
+              "raw 8 bit grayscale frames of --width x --height bytes on stdin")
+		("shm", po::value<std::string>(&args.shm),
+              "name of a shared memory ring of raw 8 bit grayscale frames")
+		("merge", po::value<std::vector<std::string>>(&args.merge)->multitoken(),
+              "calibrate from the detection files written by --shard-count runs")
+		("width", po::value<int>(&args.width), "width of raw frames")
+		("height", po::value<int>(&args.height), "height of raw frames")
+		("conf,c", po::value<std::string>(&args.conf)->required(), "configuration file")
+		("name,n", po::value<std::string>(&args.name)->required(),
               "name of camera will result in /out/<name>.yml")
-		("out,o", po::value<std::string>(&out)->required(), 
+		("out,o", po::value<std::string>(&args.out)->required(),
               "out directory where camera.yml, log.csv and summary.json will be stored")
+		("sensor", po::value<std::string>(&args.sensor),
+              "sensor file with sensor size and capture modes, a camera yml is derived for every mode")
+		("sensor-width", po::value<double>(&args.sensorWidth)->default_value(3.200),
+              "sensor width in mm, used when the sensor file gives none")
+		("sensor-height", po::value<double>(&args.sensorHeight)->default_value(2.400),
+              "sensor height in mm, used when the sensor file gives none")
+		("batch,b", po::bool_switch(&args.batch),
+              "accept every detection without the review window (always on for video, streams and raw frames)")
+		("thumbnails", po::bool_switch(&args.thumbnails),
+              "write annotated thumbnails and out/thumbs/index.html for reviewing the run afterwards")
+		("thumb-size", po::value<int>(&args.thumbSize)->default_value(320),
+              "longest side of the thumbnails")
+		("compare-init", po::bool_switch(&args.compareInit),
+              "calibrate a second time with the other Initialization and report both")
+		("prefetch-threads", po::value<int>(&args.prefetchThreads)->default_value(2),
+              "threads reading and decoding images ahead of detection")
+		("prefetch-mb", po::value<size_t>(&args.prefetchMb)->default_value(512),
+              "memory budget for decoded images waiting for detection")
+		("shard-index", po::value<int>(&args.shardIndex)->default_value(0),
+              "which slice of the input this run detects in, from 0")
+		("shard-count", po::value<int>(&args.shardCount),
+              "split the input into this many slices, detect in one and write "
+              "out/detections_<index>_of_<count>.yml.gz instead of calibrating")
 		;
 
 	po::variables_map vm;
@@ -44,146 +117,392 @@ bool read_cmd_line(int argc, char *argv[],
 	}
 
 	po::notify(vm);
+
+	if(vm.count("path") + vm.count("manifest") + vm.count("video") + vm.count("stream")
+			+ vm.count("shm") + vm.count("merge") + args.rawStdin != 1){
+		throw std::runtime_error("Exactly one of --path, --manifest, --video, --stream,"
+				" --raw-stdin, --shm or --merge is required!");
+	}
+
+	args.sharded = vm.count("shard-count") > 0;
+	if(args.sharded){
+		if(!vm.count("path") && !vm.count("manifest")){
+			throw std::runtime_error("Sharding needs --path or --manifest input!");
+		}
+		if(args.shardCount < 1 || args.shardIndex < 0 || args.shardIndex >= args.shardCount){
+			throw std::runtime_error("--shard-index must be in [0, --shard-count)!");
+		}
+		if(args.thumbnails){
+			throw std::runtime_error("--thumbnails is not supported with sharding!");
+		}
+	}
+
+	if((args.rawStdin || vm.count("shm")) && (args.width <= 0 || args.height <= 0)){
+		throw std::runtime_error("Raw frames need --width and --height!");
+	}
+
 	return true;
 }
 
+// offset is set to the input position of the first frame the source delivers
+static std::unique_ptr<ImageSource> openSource(const CmdArgs &args, int &offset)
+{
+	const size_t budget = args.prefetchMb * 1024 * 1024;
+	offset = 0;
+
+	if(!args.impath.empty() || !args.manifest.empty()){
+		std::vector<std::string> files = !args.impath.empty() ?
+			FileSource::listDirectory(args.impath) : FileSource::readManifest(args.manifest);
+
+		// contiguous slices keep neighbouring frames, and the duplicate filter, together
+		if(args.sharded){
+			const size_t begin = files.size() * args.shardIndex / args.shardCount;
+			const size_t end = files.size() * (args.shardIndex + 1) / args.shardCount;
+			files = std::vector<std::string>(files.begin() + begin, files.begin() + end);
+			offset = static_cast<int>(begin);
+		}
+
+		return std::make_unique<FileSource>(files, args.prefetchThreads, budget);
+	}
+	else if(args.rawStdin){
+		return std::make_unique<RawStdinSource>(args.width, args.height);
+	}
+	else if(!args.shm.empty()){
+		return std::make_unique<ShmRingSource>(args.shm, args.width, args.height);
+	}
+	return std::make_unique<VideoSource>(args.video + args.stream, budget);
+}
+
+static const char *initName(InitType type)
+{
+	return type == InitType::INIT_ZHANG ? "ZHANG" : "DEFAULT";
+}
+
+// show detection and let the user choose, true if points should be added.
+// draws on a copy, the frame still goes to the thumbnails and the source
+static bool review(const cv::Mat &image, cv::Size patternSize,
+		const vecp2f &foundPoints, const std::string &label)
+{
+	cv::Mat shown = image.clone();
+	cv::drawChessboardCorners(shown, patternSize, foundPoints, true);
+	cv::imshow("Corners", shown);
+	cv::setWindowProperty("Corners",
+			cv::WINDOW_NORMAL | cv::WINDOW_GUI_EXPANDED,
+			cv::WND_PROP_AUTOSIZE);
+
+	cv::resizeWindow("Corners", 512, 512);
+
+	std::cout << "Press (a) for adding points, or press (n) for not adding points\n";
+
+	while(true){
+		char key = (char)cv::waitKey(0);
+		if(key == 'a'){
+			return true;
+		}
+		else if(key == 'n'){
+			std::cout << "image " << label << " not added." << "\n";
+			return false;
+		}
+		else{
+			std::cout << "Press a or n!\n";
+		}
+	}
+}
+
 
 int main(int argc, char *argv[])
 {
 
 	try{
-		std::string impath, out, conf, name; 
+		CmdArgs args;
 
-		if(!read_cmd_line(argc, argv, impath, 
-                      conf, out, name)){
+		if(!read_cmd_line(argc, argv, args)){
 			return 0;
 		}
 
-		assert(fs::path(conf).extension() == ".yml");
-		assert(fs::is_directory(out));
-		assert(fs::is_directory(impath));
+		assert(fs::path(args.conf).extension() == ".yml");
+		assert(fs::is_directory(args.out));
+		assert(args.impath.empty() || fs::is_directory(args.impath));
 
-    assert(!fs::exists(fs::path(out+"/"+name)));
+		assert(!fs::exists(fs::path(args.out + "/" + args.name)));
 
-		YAML::Node ymlConf = YAML::LoadFile(conf);
+		const bool interactive = !args.batch && !args.sharded
+			&& (!args.impath.empty() || !args.manifest.empty());
 
-		Camera cam("test");	
+		YAML::Node ymlConf = YAML::LoadFile(args.conf);
+
+		Camera cam(args.name);
 		CalibrationConfig calibConf(ymlConf);
+		CoverageMap coverage(ymlConf["Coverage"]);
+		BlurFilter blur(ymlConf["BlurFilter"]);
+		DuplicateFilter dedup(ymlConf["DuplicateFilter"]);
+		CornerRefiner refiner(ymlConf["SubPix"], calibConf);
+		SensorModes sensorModes(args.sensor.empty() ? YAML::Node() : YAML::LoadFile(args.sensor));
+		std::unique_ptr<ThumbnailWriter> thumbs = args.thumbnails ?
+			std::make_unique<ThumbnailWriter>(args.out, args.thumbSize, 64) : nullptr;
 
 
 		std::vector<std::vector<cv::Point2f>> allCrnrs;
 		std::vector<cv::Point2f> foundPoints;
 		std::vector<std::vector<cv::Point3f>> worldSpaceCornerPoints;
 
-		/* todo check this! */
-		cv::TermCriteria criteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, 30, 0.001);
-		bool found = false;
-
-    // what are those??
-		int im_idx = 0, added = 0;
+		// detection reuses foundPoints, the board never changes so it is built once
+		foundPoints.reserve(calibConf.patternSize().area());
+		std::vector<cv::Point3f> board;
+		createKnownBoardDim(calibConf.patternSize(), calibConf.dim(), board);
+
+		int im_idx = 0;
+		bool stopped = false;
+
+		DetectionSet detections;
+		detections.patternSize = calibConf.patternSize();
+		detections.squareSize = calibConf.dim();
+		detections.shardIndex = args.shardIndex;
+		detections.shardCount = args.shardCount;
+		int inputIndex = 0;
+
+		auto setImageSize = [&](cv::Size size){
+			cam.setPixWidth(size.width);
+			cam.setPixHeight(size.height);
+
+			cam.setSensorWidth(sensorModes.sensorWidth() > 0.0 ?
+					sensorModes.sensorWidth() : args.sensorWidth);
+			cam.setSensorHeight(sensorModes.sensorHeight() > 0.0 ?
+					sensorModes.sensorHeight() : args.sensorHeight);
+		};
+
+		// detect in one grayscale image, false when ingestion should stop
+		auto ingest = [&](cv::Mat &image, const std::string &label) -> bool {
+
+			if(im_idx++ == 0){
+				setImageSize(image.size());
+				detections.imageSize = image.size();
+			}
 
-		std::vector<std::tuple<bool, std::string>> imageInformation;
+			if(!blur.accept(image)){
+				std::cout << label << " skipped, blur score " << blur.lastScore() << "\n";
+				return true;
+			}
 
-		// collect points in image 
-		for(const auto& en : fs::directory_iterator(impath)){
+			// after the blur filter so blurred frames never enter the window
+			if(!dedup.accept(image)){
+				std::cout << label << " skipped, duplicate at distance "
+					<< dedup.lastDistance() << "\n";
+				return true;
+			}
 
-      cv::Mat image;
+			auto detStart = clk::now();
+			bool found = calibConf.findPoints(image, foundPoints);
+			blur.detectionTook(
+					std::chrono::duration<double, std::milli>(clk::now() - detStart).count());
 
-      image = cv::imread(en.path(), cv::IMREAD_GRAYSCALE);
-      if(image.empty()){
-        std::cout << "Unable to read file " << en.path() << "\n";
-        continue;
-      }
+			if(!found){
+				if(thumbs){
+					thumbs->submit(image, label, calibConf.patternSize(), vecp2f(), 0.0, -1);
+				}
+				return true;
+			}
 
-      std::cout << en.path() << std::endl;
-      std::cout << "image size " << image.size[1] << " "<< image.size[0] << std::endl;
+			cv::Scalar scales =
+				estimateChessboardSharpness(image, calibConf.patternSize(), foundPoints);
+			std::cout << label << std::endl;
+			std::cout << scales << std::endl;
+			refiner.refine(image, foundPoints);
 
+			const bool accepted = !interactive ||
+				review(image, calibConf.patternSize(), foundPoints, label);
 
-			std::vector<cv::Point3f> worldCoords;
+			if(thumbs){
+				thumbs->submit(image, label, calibConf.patternSize(), foundPoints, scales[0],
+						accepted ? static_cast<int>(allCrnrs.size()) : -1);
+			}
 
-			if(im_idx == 0){
-				/* cam.setPixWidth(image.size[1]/2); */
-				/* cam.setPixHeight(image.size[0]/2); */
+			if(!accepted){
+				return true;
+			}
 
-				cam.setPixWidth(image.size[1]);
-				cam.setPixHeight(image.size[0]);
+			coverage.add(foundPoints, board, image.size());
 
-				// this is the 1" sensor in mm (air2s)
-				/* cam.setSensorWidth(13.200); */
-				/* cam.setSensorHeight(8.800); */
-        
-        // roxcon -- TODO: make as input
-				cam.setSensorWidth(3.200);
-				cam.setSensorHeight(2.400);
+			allCrnrs.push_back(foundPoints);
+			worldSpaceCornerPoints.push_back(board);
 
+			if(args.sharded){
+				detections.add(inputIndex, label, foundPoints);
+				// only the merge sees all views, a shard can't decide to stop
+				return true;
 			}
 
+			if(coverage.earlyStop() && coverage.targetsMet()){
+				std::cout << "Coverage targets met after " << im_idx
+					<< " images, " << coverage.views() << " views" << std::endl;
+				return false;
+			}
 
-			found = calibConf.findPoints(image, foundPoints);
-
-      if(found){
-        cv::Scalar scales = 
-          estimateChessboardSharpness(image, calibConf.patternSize(), foundPoints); 
-        std::cout << en.path() << std::endl;
-        std::cout << scales << std::endl;
-        std::cout << "image size " << image.size[1] << " "<< image.size[0] << std::endl;
-        // is this always necessary??
-        cv::cornerSubPix(image, foundPoints, cv::Size(11, 11), cv::Size(-1, -1), criteria);
-
-        cv::drawChessboardCorners(image, calibConf.patternSize(), foundPoints, found);
-        cv::imshow("Corners", image);
-        cv::setWindowProperty("Corners", 
-            cv::WINDOW_NORMAL | cv::WINDOW_GUI_EXPANDED, 
-            cv::WND_PROP_AUTOSIZE);
+			return true;
+		};
 
-        cv::resizeWindow("Corners", 512, 512);
+		if(!args.merge.empty()){
+			DetectionSet merged = DetectionSet::merge(args.merge);
 
-        std::cout << "Press (a) for adding points, or press (n) for not adding points\n";
+			if(merged.patternSize != calibConf.patternSize()
+					|| std::abs(merged.squareSize - calibConf.dim()) > 1e-6){
+				throw std::runtime_error("Detection files were made with another pattern than "
+						+ args.conf);
+			}
 
-        // show and choose	
-        while(true){
-          if((char)cv::waitKey(0) == 'a'){
-            allCrnrs.push_back(foundPoints);
-            createKnownBoardDim(calibConf.patternSize(),
-                calibConf.dim(), 
-                worldCoords);
-            worldSpaceCornerPoints.push_back(worldCoords);
-            added++;
-            break;
-          }
-          else if((char)cv::waitKey(0) == 'n'){
-            std::cout << "image " << en.path() << "not added." << "\n";
-            break;
-          }
-          else{
-            std::cout << "Press a or n!\n";
-          }
-        }
-      }
+			std::cout << "Merged " << args.merge.size() << " of " << merged.shardCount
+				<< " shards, " << merged.views() << " views from "
+				<< merged.framesProcessed << " images" << std::endl;
 
-    }
+			im_idx = merged.framesProcessed;
+			if(merged.views() > 0){
+				setImageSize(merged.imageSize);
+			}
+			for(const auto &corners : merged.corners){
+				coverage.add(corners, board, merged.imageSize);
+				allCrnrs.push_back(corners);
+				worldSpaceCornerPoints.push_back(board);
+			}
+		}
+		else{
+			// collect points in images
+			int offset = 0;
+			std::unique_ptr<ImageSource> source = openSource(args, offset);
+			Frame frame;
+
+			while(source->next(frame)){
+				if(frame.image.empty()){
+					std::cout << "Unable to read file " << frame.label << "\n";
+					continue;
+				}
+
+				inputIndex = offset + static_cast<int>(frame.index);
+				if(!ingest(frame.image, frame.label)){
+					stopped = true;
+					break;
+				}
+			}
+			// stops the prefetching threads
+			source.reset();
+
+			std::cout << im_idx << " images processed"
+				<< (stopped ? " (stopped early)" : "") << std::endl;
+			std::cout << "coverage " << coverage.coverage()
+				<< " tilt bins " << coverage.tiltBinsFilled() << std::endl;
+			if(blur.enabled()){
+				std::cout << "blur filter skipped " << blur.skipped()
+					<< " of " << blur.evaluated() << " images, saved ~"
+					<< blur.savedMs() << " ms" << std::endl;
+			}
+			if(dedup.enabled()){
+				std::cout << "duplicate filter dropped " << dedup.dropped()
+					<< " of " << dedup.evaluated() << " images" << std::endl;
+			}
 
-    std::cout << im_idx++ << std::endl;
+			if(args.sharded){
+				detections.framesProcessed = im_idx;
+				const std::string path = args.out + "/detections_" + std::to_string(args.shardIndex)
+					+ "_of_" + std::to_string(args.shardCount) + ".yml.gz";
+				detections.write(path);
+				std::cout << detections.views() << " views written to " << path << std::endl;
+				return 0;
+			}
+		}
 
 		if(allCrnrs.size() > 0){
 			std::cout << "Starting calibration!" << std::endl;
 
+			// with --compare-init both solves skip the uncertainties so their times
+			// compare, dumpStats computes them for this one afterwards
+			auto calStart = clk::now();
 			double rms = cam.calibrate(worldSpaceCornerPoints,
-					allCrnrs, 
-					calibConf);
+					allCrnrs,
+					calibConf,
+					0,
+					args.compareInit);
+			const double calMs =
+				std::chrono::duration<double, std::milli>(clk::now() - calStart).count();
+
+			// only the sparse solver reports its iterations, OpenCV's don't
+			std::cout << "Calibration finished in " << calMs << " ms, "
+				<< initName(calibConf.initType()) << " start";
+			if(cam.iterations() >= 0){
+				std::cout << ", " << cam.iterations() << " iterations";
+			}
+			std::cout << std::endl;
 
-			std::cout << "Calibration finished" << std::endl;
+			std::ostringstream initJs;
+			initJs << "{\"type\" : \"" << initName(calibConf.initType())
+				<< "\", \"ms\" : " << calMs;
+			if(cam.iterations() >= 0){
+				initJs << ", \"iterations\" : " << cam.iterations();
+			}
+
+			if(args.compareInit){
+				YAML::Node otherYml = YAML::Clone(ymlConf);
+				otherYml["Initialization"] = calibConf.initType() == InitType::INIT_ZHANG ?
+					"DEFAULT" : "ZHANG";
+				CalibrationConfig otherConf(otherYml);
+
+				Camera other(args.name);
+				other.setPixWidth(cam.pixWidth());
+				other.setPixHeight(cam.pixHeight());
+
+				auto otherStart = clk::now();
+				double otherRms = other.calibrate(worldSpaceCornerPoints, allCrnrs, otherConf,
+						0, true);
+				const double otherMs =
+					std::chrono::duration<double, std::milli>(clk::now() - otherStart).count();
+
+				std::cout << "With " << initName(otherConf.initType()) << " start: "
+					<< otherMs << " ms, ";
+				if(other.iterations() >= 0){
+					std::cout << other.iterations() << " iterations, ";
+				}
+				std::cout << "RMS " << otherRms << std::endl;
+
+				initJs << ", \"compare\" : {\"type\" : \"" << initName(otherConf.initType())
+					<< "\", \"ms\" : " << otherMs;
+				if(other.iterations() >= 0){
+					initJs << ", \"iterations\" : " << other.iterations();
+				}
+				initJs << ", \"rms\" : " << otherRms << "}";
+			}
+			initJs << "}";
 
 			std::cout << "=== Calibration result ===" << std::endl;
 			std::cout << "== RMS:" << rms << std::endl;
-			cam.write(out);
+			Residuals residuals;
+			cam.evaluateResiduals(worldSpaceCornerPoints, allCrnrs, residuals);
+			residuals.writeCsv(args.out + "/residuals.csv");
+
+			cam.write(args.out);
 			cam.print();
-			cam.dumpStats(out);
+			cam.dumpStats(args.out, {
+					{"coverage", coverage.toJson()},
+					{"residuals", residuals.toJson()},
+					{"blur_filter", blur.toJson()},
+					{"duplicate_filter", dedup.toJson()},
+					{"initialization", initJs.str()}
+					});
+
+			for(const auto &mode : sensorModes.modes()){
+				Camera derived = sensorModes.derive(cam, mode);
+				derived.write(args.out);
+				std::cout << "Derived " << derived.name() << " for mode "
+					<< mode.size.width << "x" << mode.size.height << std::endl;
+			}
 		}
 		else{
 			std::cout << "No points found!\n";
 		}
 
+		if(thumbs){
+			thumbs->finish(cam.isCalibrated() ? cam.getViewErrors() : cv::Mat());
+			std::cout << "Thumbnails in " << args.out << "/thumbs/index.html, "
+				<< thumbs->dropped() << " dropped" << std::endl;
+		}
+
 	}
 	catch(std::exception const & e) {
 		std::cerr << e.what() << std::endl;
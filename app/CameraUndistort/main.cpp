@@ -3,6 +3,7 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/calib3d.hpp>
+#include <opencv2/videoio.hpp>
 
 #include <boost/program_options.hpp>
 
@@ -12,23 +13,65 @@
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <algorithm>
+#include <vector>
 
 #include "utils.hpp"
 #include "camera.hpp"
+#include "queue.hpp"
+#include "sensormode.hpp"
+#include "undistortlut.hpp"
 
 namespace fs = std::filesystem;
 namespace po = boost::program_options;
+using clk = std::chrono::steady_clock;
 
-bool read_cmd_line(std::string &calib, 
-									std::string &image)
+struct CmdArgs {
+	std::string calib;
+	std::string image;
+	std::string video;
+	std::string points;
+	std::string out;
+	std::string fourcc;
+	std::string modes;
+	std::string mode;
+	int threads = 0;
+	int queueDepth = 0;
+	int lutStep = 0;
+	bool realtime = false;
+};
 
+bool read_cmd_line(int argc, char *argv[], CmdArgs &args)
 {
 	po::options_description opt("CameraUndistort");
 
 	opt.add_options()
 		("help,h", "produce help message")
-		("calib,c", po::value<std::string>(&calib)->required(), "camera parameters")
-		("image,i", po::value<std::string>(&image)->required(), "input image path")
+		("calib,c", po::value<std::string>(&args.calib)->required(), "camera parameters")
+		("image,i", po::value<std::string>(&args.image), "input image path")
+		("video,v", po::value<std::string>(&args.video), "input video path")
+		("points,p", po::value<std::string>(&args.points),
+              "text file with one distorted pixel \"x y\" per line, written undistorted as csv")
+		("lut-step,l", po::value<int>(&args.lutStep)->default_value(0),
+              "undistort points through a lookup table with nodes this many pixels apart, 0 exact")
+		("out,o", po::value<std::string>(&args.out)->required(), "output image or video path")
+		("modes,m", po::value<std::string>(&args.modes),
+              "sensor mode file declaring crops/scales of the calibrated camera")
+		("mode", po::value<std::string>(&args.mode),
+              "sensor mode the input was captured in")
+		("fourcc", po::value<std::string>(&args.fourcc)->default_value("mp4v"),
+              "output video codec")
+		("threads,t", po::value<int>(&args.threads)->default_value(
+              std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2)),
+              "remap worker threads")
+		("queue,q", po::value<int>(&args.queueDepth)->default_value(16),
+              "frames buffered between decode, remap and encode")
+		("realtime,r", po::bool_switch(&args.realtime),
+              "drop decoded frames instead of waiting when the remap workers fall behind")
 		;
 
 	po::variables_map vm;
@@ -40,17 +83,257 @@ bool read_cmd_line(std::string &calib,
 	}
 
 	po::notify(vm);
+
+	if(vm.count("image") + vm.count("video") + vm.count("points") != 1){
+		throw std::runtime_error("Exactly one of --image, --video or --points is required!");
+	}
+	if(args.lutStep < 0){
+		throw std::runtime_error("--lut-step can't be negative!");
+	}
+	if(vm.count("mode") != vm.count("modes")){
+		throw std::runtime_error("--mode and --modes go together!");
+	}
+	if(args.threads < 1 || args.queueDepth < 1){
+		throw std::runtime_error("threads and queue must be at least 1!");
+	}
+	if(args.fourcc.size() != 4){
+		throw std::runtime_error("fourcc must be four characters!");
+	}
+
 	return true;
 }
 
+struct Job {
+	size_t seq;
+	cv::Mat frame;
+};
+
+struct PipelineStats {
+	std::atomic<size_t> decoded{0};
+	std::atomic<size_t> dropped{0};
+	std::atomic<size_t> written{0};
+	size_t maxReorder = 0;
+	size_t maxInQueue = 0;
+};
+
+static void report(const PipelineStats &stats, clk::time_point start,
+		const BoundedQueue<Job> &in, size_t reorder)
+{
+	double secs = std::chrono::duration<double>(clk::now() - start).count();
+	std::cout << "written " << stats.written
+		<< " decoded " << stats.decoded
+		<< " dropped " << stats.dropped
+		<< " queued " << in.size()
+		<< " reorder " << reorder
+		<< " fps " << (secs > 0.0 ? stats.written / secs : 0.0)
+		<< std::endl;
+}
+
+/*
+ * decode -> remap workers -> re-sequence -> encode, all stages overlap.
+ * The decoder tags every accepted frame with a sequence number, workers
+ * finish out of order and the writer puts frames back in sequence.
+ */
+static void undistortVideo(const Camera &modeCam, const CmdArgs &args)
+{
+	cv::VideoCapture cap(args.video);
+	if(!cap.isOpened()){
+		throw std::runtime_error("Unable to open " + args.video);
+	}
+
+	const cv::Size size(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+			static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+	double fps = cap.get(cv::CAP_PROP_FPS);
+	if(fps <= 0.0){
+		fps = 30.0;
+	}
+
+	// maps are built once and only read by the workers, copies share them
+	Camera cam(modeCam);
+	if(!cam.hasUndistortMaps(size)){
+		cam.initUndistortMaps(size);
+	}
+
+	cv::VideoWriter writer(args.out,
+			cv::VideoWriter::fourcc(args.fourcc[0], args.fourcc[1], args.fourcc[2], args.fourcc[3]),
+			fps, size, true);
+	if(!writer.isOpened()){
+		throw std::runtime_error("Unable to open " + args.out + " for writing");
+	}
+
+	BoundedQueue<Job> in(args.queueDepth);
+	BoundedQueue<Job> out(args.queueDepth);
+	PipelineStats stats;
+
+	const auto start = clk::now();
+
+	std::thread decoder([&](){
+		size_t seq = 0;
+		while(true){
+			Job job;
+			if(!cap.read(job.frame)){
+				break;
+			}
+			stats.decoded++;
+			job.seq = seq;
+
+			if(args.realtime){
+				if(!in.tryPush(std::move(job))){
+					stats.dropped++;
+					continue;
+				}
+			}
+			else if(!in.push(std::move(job))){
+				break;
+			}
+			seq++;
+		}
+		in.close();
+	});
+
+	std::vector<std::thread> workers;
+	std::atomic<int> running(args.threads);
+
+	for(int i = 0; i < args.threads; i++){
+		workers.emplace_back([&](){
+			Job job;
+			while(in.pop(job)){
+				Job done;
+				done.seq = job.seq;
+				cam.undistortImage(job.frame, done.frame);
+				out.push(std::move(done));
+			}
+			if(--running == 0){
+				out.close();
+			}
+		});
+	}
+
+	// encoder, re-sequences on the calling thread
+	std::map<size_t, cv::Mat> reorder;
+	size_t nextSeq = 0;
+	auto lastReport = start;
+	Job job;
+
+	while(out.pop(job)){
+		reorder.emplace(job.seq, std::move(job.frame));
+		stats.maxReorder = std::max(stats.maxReorder, reorder.size());
+		stats.maxInQueue = std::max(stats.maxInQueue, in.size());
+
+		for(auto it = reorder.find(nextSeq); it != reorder.end(); it = reorder.find(nextSeq)){
+			writer.write(it->second);
+			reorder.erase(it);
+			nextSeq++;
+			stats.written++;
+		}
+
+		if(clk::now() - lastReport > std::chrono::seconds(2)){
+			report(stats, start, in, reorder.size());
+			lastReport = clk::now();
+		}
+	}
+
+	decoder.join();
+	for(auto &w : workers){
+		w.join();
+	}
+	writer.release();
+
+	std::cout << "=== Undistortion finished ===" << std::endl;
+	report(stats, start, in, reorder.size());
+	std::cout << "max queued " << stats.maxInQueue
+		<< " max reorder " << stats.maxReorder << std::endl;
+}
+
+/*
+ * Undistorts a list of pixel coordinates, exactly or through an
+ * UndistortLUT. The table is only worth building for many points, its
+ * interpolation error against the exact inversion is reported.
+ */
+static void undistortPointFile(const Camera &cam, const CmdArgs &args)
+{
+	std::ifstream in(args.points);
+	if(!in.is_open()){
+		throw std::runtime_error("Unable to open " + args.points);
+	}
+
+	vecp2f points;
+	std::string line;
+	while(std::getline(in, line)){
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::istringstream fields(line);
+		cv::Point2f p;
+		if(fields >> p.x >> p.y){
+			points.push_back(p);
+		}
+	}
+
+	vecp2f undist;
+	const auto start = clk::now();
+
+	if(args.lutStep > 0){
+		if(cam.pixWidth() <= 0.0 || cam.pixHeight() <= 0.0){
+			throw std::runtime_error(args.calib + " records no image size to build the table"
+					" for, use --lut-step 0");
+		}
+		auto lut = UndistortLUT::build(cam, cv::Size(static_cast<int>(cam.pixWidth()),
+					static_cast<int>(cam.pixHeight())), args.lutStep);
+		std::cout << "lookup table step " << lut->step()
+			<< " max error " << lut->maxError()
+			<< " mean error " << lut->meanError() << " px" << std::endl;
+		lut->undistortPoints(points, undist);
+	}
+	else{
+		undist = cam.undistortPoints(points);
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(clk::now() - start).count();
+
+	std::ofstream out(args.out);
+	if(!out.is_open()){
+		throw std::runtime_error("Unable to open " + args.out + " for writing");
+	}
+	out << "x,y,undistorted_x,undistorted_y\n";
+	for(size_t i = 0; i < points.size(); i++){
+		out << points[i].x << ',' << points[i].y << ','
+			<< undist[i].x << ',' << undist[i].y << "\n";
+	}
+
+	std::cout << "undistorted " << points.size() << " points in " << ms << " ms" << std::endl;
+}
 
 int main(int argc, char *argv[])
 {
 
 	try{
-		std::string im_path, camera_conf;
-		
+		CmdArgs args;
+
+		if(!read_cmd_line(argc, argv, args)){
+			return 0;
+		}
+
+		Camera cam(YAML::LoadFile(args.calib));
+
+		if(!cam.isCalibrated()){
+			throw std::runtime_error(args.calib + " holds no calibrated camera");
+		}
+
+		SensorModes modes(args.modes.empty() ? YAML::Node() : YAML::LoadFile(args.modes));
+		const Camera &active = args.mode.empty() ? cam : modes.undistorter(cam, args.mode);
 
+		if(!args.image.empty()){
+			cv::Mat image = cv::imread(args.image, cv::IMREAD_UNCHANGED);
+			if(image.empty()){
+				throw std::runtime_error("Unable to read " + args.image);
+			}
+			cv::imwrite(args.out, active.undistortImage(image));
+		}
+		else if(!args.points.empty()){
+			undistortPointFile(active, args);
+		}
+		else{
+			undistortVideo(active, args);
+		}
 
 	}
 	catch(std::exception const &e) {
@@ -0,0 +1,370 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cmath>
+
+#include "camera.hpp"
+#include "imagesource.hpp"
+#include "refine.hpp"
+#include "utils.hpp"
+
+namespace po = boost::program_options;
+namespace fs = std::filesystem;
+using clk = std::chrono::steady_clock;
+
+/*
+ * Checks stored camera models against fresh validation images without
+ * recalibrating. The board is detected in every image, its pose found
+ * with solvePnP under the stored intrinsics and distortion, and the
+ * reprojection error of the corners measures how far the optics have
+ * drifted from the model. All images of all models are processed in one
+ * parallel loop and the models are ranked worst first.
+ *
+ * The fleet file lists the models, relative paths are relative to it:
+ *
+ *   Models:
+ *     - Camera: cams/air2s_0001.yml
+ *       Images: validation/air2s_0001/
+ *       Config: circles.yml      # optional, --conf otherwise
+ */
+
+struct CmdArgs {
+	std::string conf;
+	std::string fleet;
+	std::string out;
+	int maxImages = 0;
+	double maxRms = 1.0;
+	int minViews = 3;
+};
+
+struct Model {
+	std::string file;
+	std::string conf;
+	std::unique_ptr<Camera> cam;
+	std::string error; // set if the model could not be checked at all
+};
+
+struct View {
+	size_t model;
+	std::string file;
+	bool found = false;
+	double rms = 0.0;
+	double maxError = 0.0;
+	std::string error;
+	std::string note;
+};
+
+struct ModelReport {
+	size_t model;
+	int images = 0;
+	int found = 0;
+	double medianRms = 0.0;
+	double p90Rms = 0.0;
+	double maxError = 0.0;
+	bool pass = false;
+};
+
+// what every image checked with one calibration configuration needs
+struct Detector {
+	std::unique_ptr<CalibrationConfig> conf;
+	std::unique_ptr<CornerRefiner> refiner;
+	vecp3f board;
+};
+
+bool read_cmd_line(int argc, char *argv[], CmdArgs &args)
+{
+	po::options_description opt("Validate options");
+
+	opt.add_options()
+		("help,h", "produce help message")
+		("conf,c", po::value<std::string>(&args.conf)->required(),
+              "calibration configuration describing the board")
+		("fleet,f", po::value<std::string>(&args.fleet)->required(),
+              "yml listing the camera models and their validation images")
+		("out,o", po::value<std::string>(&args.out)->required(), "output directory")
+		("max-images,n", po::value<int>(&args.maxImages)->default_value(0),
+              "images per model picked evenly from its directory, 0 for all")
+		("max-rms,r", po::value<double>(&args.maxRms)->default_value(1.0),
+              "median per-view reprojection rms in pixels a model may reach")
+		("min-views,m", po::value<int>(&args.minViews)->default_value(3),
+              "views the board must be found in for a model to pass")
+		;
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(opt).run(), vm);
+
+	if(vm.count("help")){
+		std::cout << opt << std::endl;
+		return false;
+	}
+
+	po::notify(vm);
+
+	if(args.maxImages < 0 || args.maxRms <= 0.0 || args.minViews < 1){
+		throw std::runtime_error("--max-images can't be negative, --max-rms and --min-views"
+				" must be positive!");
+	}
+
+	return true;
+}
+
+static std::string resolve(const fs::path &base, const std::string &path)
+{
+	const fs::path p(path);
+	return p.is_absolute() ? p.string() : (base / p).lexically_normal().string();
+}
+
+static std::vector<std::string> pickImages(const std::string &dir, int maxImages)
+{
+	const std::vector<std::string> files = FileSource::listDirectory(dir);
+	if(maxImages == 0 || files.size() <= static_cast<size_t>(maxImages)){
+		return files;
+	}
+
+	std::vector<std::string> picked;
+	for(size_t i = 0; i < static_cast<size_t>(maxImages); i++){
+		picked.push_back(files[i * files.size() / maxImages]);
+	}
+	return picked;
+}
+
+static void checkView(const Camera &cam, const Detector &det, View &view)
+{
+	const cv::Mat image = cv::imread(view.file, cv::IMREAD_GRAYSCALE);
+	if(image.empty()){
+		view.error = "not an image";
+		return;
+	}
+	if(cam.pixWidth() <= 0.0 || cam.pixHeight() <= 0.0){
+		// camera files written before the image size was stored
+		view.note = "model records no image size, size not checked";
+	}
+	else if(image.cols != static_cast<int>(cam.pixWidth())
+			|| image.rows != static_cast<int>(cam.pixHeight())){
+		view.error = "image is " + std::to_string(image.cols) + "x"
+			+ std::to_string(image.rows) + ", the model is not";
+		return;
+	}
+
+	vecp2f corners;
+	if(!det.conf->findPoints(image, corners)){
+		return;
+	}
+	det.refiner->refine(image, corners);
+
+	cv::Mat rvec, tvec;
+	if(!cv::solvePnP(det.board, corners, cam.getIntrinsics(), cam.getDistortionParams(),
+				rvec, tvec)){
+		view.error = "no pose";
+		return;
+	}
+
+	vecp2f projected;
+	cv::projectPoints(det.board, rvec, tvec, cam.getIntrinsics(), cam.getDistortionParams(),
+			projected);
+
+	double sum = 0.0;
+	for(size_t k = 0; k < corners.size(); k++){
+		const double e = cv::norm(projected[k] - corners[k]);
+		sum += e * e;
+		view.maxError = std::max(view.maxError, e);
+	}
+	view.rms = std::sqrt(sum / corners.size());
+	view.found = true;
+}
+
+static double quantile(std::vector<double> values, double q)
+{
+	const size_t k = std::min(values.size() - 1, static_cast<size_t>(q * values.size()));
+	std::nth_element(values.begin(), values.begin() + k, values.end());
+	return values[k];
+}
+
+int main(int argc, char *argv[])
+{
+	try{
+		CmdArgs args;
+
+		if(!read_cmd_line(argc, argv, args)){
+			return 0;
+		}
+
+		auto start = clk::now();
+
+		const fs::path fleetDir = fs::path(args.fleet).parent_path();
+		const YAML::Node fleet = YAML::LoadFile(args.fleet);
+		if(!fleet["Models"] || !fleet["Models"].IsSequence()){
+			throw std::runtime_error(args.fleet + " has no Models list!\n");
+		}
+
+		// one detector per configuration file, shared by every model using it;
+		// findPoints and refine can be called from several threads at once
+		std::map<std::string, Detector> detectors;
+		std::vector<Model> models;
+		std::vector<View> views;
+
+		for(const auto &entry : fleet["Models"]){
+			Model model;
+			model.file = resolve(fleetDir, entry["Camera"].as<std::string>());
+			model.conf = entry["Config"] ? resolve(fleetDir, entry["Config"].as<std::string>())
+				: args.conf;
+
+			try{
+				model.cam = std::make_unique<Camera>(YAML::LoadFile(model.file));
+				if(!model.cam->isCalibrated()){
+					throw std::runtime_error("not calibrated");
+				}
+
+				if(!detectors.count(model.conf)){
+					const YAML::Node node = YAML::LoadFile(model.conf);
+					Detector det;
+					det.conf = std::make_unique<CalibrationConfig>(node);
+					det.refiner = std::make_unique<CornerRefiner>(node["SubPix"], *det.conf);
+					createKnownBoardDim(det.conf->patternSize(), det.conf->dim(), det.board);
+					detectors.emplace(model.conf, std::move(det));
+				}
+
+				for(const auto &file : pickImages(
+							resolve(fleetDir, entry["Images"].as<std::string>()), args.maxImages)){
+					View view;
+					view.model = models.size();
+					view.file = file;
+					views.push_back(view);
+				}
+			}
+			catch(std::exception const &e){
+				// one broken entry must not stop the rest of the fleet
+				model.error = e.what();
+				while(!model.error.empty() && model.error.back() == '\n'){
+					model.error.pop_back();
+				}
+				std::cout << "skipping " << model.file << ": " << model.error << "\n";
+			}
+
+			models.push_back(std::move(model));
+		}
+
+		std::cout << "validating " << models.size() << " models on "
+			<< views.size() << " images" << std::endl;
+
+		// every image of every model in one loop, so a model with many images
+		// doesn't leave the other threads idle
+		cv::parallel_for_(cv::Range(0, static_cast<int>(views.size())), [&](const cv::Range &range){
+			for(int i = range.start; i < range.end; i++){
+				const Model &model = models[views[i].model];
+				try{
+					checkView(*model.cam, detectors.at(model.conf), views[i]);
+				}
+				catch(std::exception const &e){
+					// one bad capture must not stop the report
+					views[i].found = false;
+					views[i].error = e.what();
+					while(!views[i].error.empty() && views[i].error.back() == '\n'){
+						views[i].error.pop_back();
+					}
+				}
+			}
+		});
+
+		std::vector<ModelReport> reports(models.size());
+		std::vector<std::vector<double>> rms(models.size());
+		for(size_t m = 0; m < models.size(); m++){
+			reports[m].model = m;
+		}
+		for(const auto &v : views){
+			ModelReport &r = reports[v.model];
+			r.images++;
+			if(v.found){
+				r.found++;
+				r.maxError = std::max(r.maxError, v.maxError);
+				rms[v.model].push_back(v.rms);
+			}
+		}
+		for(size_t m = 0; m < models.size(); m++){
+			ModelReport &r = reports[m];
+			if(!rms[m].empty()){
+				r.medianRms = quantile(rms[m], 0.5);
+				r.p90Rms = quantile(rms[m], 0.9);
+			}
+			r.pass = models[m].error.empty() && r.found >= args.minViews
+				&& r.medianRms <= args.maxRms;
+		}
+
+		// failing models first, then by drift
+		std::sort(reports.begin(), reports.end(), [](const ModelReport &a, const ModelReport &b){
+			if(a.pass != b.pass){
+				return !a.pass;
+			}
+			return a.medianRms > b.medianRms;
+		});
+
+		fs::create_directories(args.out);
+
+		std::ofstream report(args.out + "/drift.csv");
+		std::ofstream viewLog(args.out + "/views.csv");
+		if(!report.is_open() || !viewLog.is_open()){
+			throw std::runtime_error("Unable to write to " + args.out + "\n");
+		}
+
+		report << "rank,camera,model,pass,images,found,median_rms,p90_rms,max_error,error\n";
+		int failed = 0;
+		for(size_t k = 0; k < reports.size(); k++){
+			const ModelReport &r = reports[k];
+			const Model &model = models[r.model];
+			failed += r.pass ? 0 : 1;
+
+			report << k + 1 << ',' << (model.cam ? model.cam->name() : "") << ','
+				<< model.file << ',' << (r.pass ? "true" : "false") << ','
+				<< r.images << ',' << r.found << ',' << r.medianRms << ','
+				<< r.p90Rms << ',' << r.maxError << ",\"" << model.error << "\"\n";
+		}
+
+		viewLog << "model,image,found,rms,max_error,error,note\n";
+		for(const auto &v : views){
+			viewLog << models[v.model].file << ',' << v.file << ','
+				<< (v.found ? "true" : "false") << ',' << v.rms << ','
+				<< v.maxError << ",\"" << v.error << "\",\"" << v.note << "\"\n";
+		}
+
+		const double seconds = std::chrono::duration<double>(clk::now() - start).count();
+
+		std::cout << std::fixed << std::setprecision(3);
+		std::cout << "rank\tfound\tmedian\tp90\tmodel\n";
+		for(size_t k = 0; k < std::min<size_t>(reports.size(), 10); k++){
+			const ModelReport &r = reports[k];
+			std::cout << k + 1 << "\t" << r.found << "/" << r.images << "\t"
+				<< r.medianRms << "\t" << r.p90Rms << "\t" << models[r.model].file
+				<< (r.pass ? "" : "  FAIL") << "\n";
+		}
+		std::cout << failed << " of " << models.size() << " models failed, "
+			<< seconds << " s, report in " << args.out << "/drift.csv" << std::endl;
+
+		// non-zero so a release gate can stop on a drifted model
+		if(failed > 0){
+			return 2;
+		}
+
+	}
+	catch(std::exception const & e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -8,8 +8,11 @@
 #include <array>
 #include <functional>
 #include <filesystem>
-
-#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <map>
 
 #include <opencv2/core.hpp>
 #include <opencv2/calib3d.hpp>
@@ -20,6 +23,11 @@
 
 
 #include "camera.hpp"
+#include "sparsesolver.hpp"
+#include "residuals.hpp"
+#include "zhang.hpp"
+#include "circles.hpp"
+#include "utils.hpp"
 
 namespace fs = std::filesystem;
 using chsys = std::chrono::system_clock;
@@ -117,26 +125,39 @@ static const std::array<std::tuple<std::string, int>, 3> posPointFlagsCircle{
 
 static void initFlagsMaps()
 {
+	// configs are built on several threads at once, fill the maps only once
+	static std::once_flag filled;
+	std::call_once(filled, [](){
 
-	for(const auto &[f, m] : posPointFlagsChess){
-		pointFlagsChess_m[f] = m;
-	}
+		for(const auto &[f, m] : posPointFlagsChess){
+			pointFlagsChess_m[f] = m;
+		}
 
-	for(const auto &[f, m] : posPointFlagsCircle){
-		pointFlagsCircle_m[f] = m;
-	}
+		for(const auto &[f, m] : posPointFlagsCircle){
+			pointFlagsCircle_m[f] = m;
+		}
 
-	for(const auto &[f, m] : posCalibrationFlags){
-		calibrationFlags_m[f] = m;
-	}
+		for(const auto &[f, m] : posCalibrationFlags){
+			calibrationFlags_m[f] = m;
+		}
+	});
+
+}
 
+// read only lookup, operator[] would insert unknown flags into the shared maps
+static int flagValue(const std::map<std::string, int> &flags, const std::string &name)
+{
+	auto it = flags.find(name);
+	return it == flags.end() ? 0 : it->second;
 }
 
 
 CalibrationConfig::CalibrationConfig(const YAML::Node &config):
 	operationFlags(0),
 	pointFlags(0),
-	crit(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, 30, 0.001)
+	crit(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS,
+			valueOr<int>(config["TermCriteria"], "MaxIter", 30),
+			valueOr<double>(config["TermCriteria"], "Eps", 0.001))
 
 {
 
@@ -152,8 +173,8 @@ CalibrationConfig::CalibrationConfig(const YAML::Node &config):
 
 	this->dimension = config["PatternDimensions"].as<float>();
 
-	assert((!calibType.empty() && (calibType == "REGULAR" || calibType == "RO")
-				, "Calib Type is required!"));
+	assert((!calibType.empty() && (calibType == "REGULAR" || calibType == "RO"
+					|| calibType == "SPARSE"), "Calib Type is required!"));
 	
 	assert((!pointType.empty() && 
 			(pointType == "CIRCLE" || pointType == "CHESS" 
@@ -161,30 +182,22 @@ CalibrationConfig::CalibrationConfig(const YAML::Node &config):
 
 
 	for(const auto &fl : config["CalibrationFlags"].as<std::vector<std::string>>())
-		this->operationFlags |= calibrationFlags_m[fl];
+		this->operationFlags |= flagValue(calibrationFlags_m, fl);
 
 	for(const auto &fl : config["PointFlags"].as<std::vector<std::string>>())
 		this->pointFlags |= 
-          pointType == "CIRCLE" ? pointFlagsCircle_m[fl] : pointFlagsChess_m[fl];
+          flagValue(pointType == "CIRCLE" ? pointFlagsCircle_m : pointFlagsChess_m, fl);
 
 
 	if(pointType == "CIRCLE"){
 
-		using F = bool(*)(
-				cv::InputArray,
-				cv::Size,
-				cv::OutputArray,
-				int,
-				const cv::Ptr<cv::FeatureDetector>&
-				);
+		// shared so every copy of findPoints reuses the per-thread detectors
+		auto detector = std::make_shared<CircleGridDetector>(
+				config["CircleDetector"], this->ps, this->pointFlags);
 
-		findPoints = std::bind(static_cast<F>(cv::findCirclesGrid), 
-				std::placeholders::_1, 
-				this->ps, 
-				std::placeholders::_2, 
-				this->pointFlags,
-				cv::SimpleBlobDetector::create()
-				);
+		findPoints = [detector](const cv::Mat &im, vecp2f &foundPoints){
+			return detector->detect(im, foundPoints);
+		};
 
 		pt = PointType::C_CIRCLES;
 	}
@@ -228,10 +241,24 @@ CalibrationConfig::CalibrationConfig(const YAML::Node &config):
 	else if(calibType == "RO"){
 		ct = CalibType::RO;
 	}
+	else if(calibType == "SPARSE"){
+		ct = CalibType::SPARSE;
+	}
 	else{
 		throw std::runtime_error(calibType + " is not a valid calibration type!\n");
 	}
 
+	const std::string initType = valueOr<std::string>(config, "Initialization", "DEFAULT");
+	if(initType == "DEFAULT"){
+		it = InitType::INIT_DEFAULT;
+	}
+	else if(initType == "ZHANG"){
+		it = InitType::INIT_ZHANG;
+	}
+	else{
+		throw std::runtime_error(initType + " is not a valid initialization!\n");
+	}
+
 
 }
 
@@ -265,6 +292,10 @@ static std::string loadCameraSchema(const std::string &name)
 	cmra += "Camera.widthPix: 0.0\n";
 	cmra += "Camera.heightPix: 0.0\n";
 
+	/* sensor size in mm */
+	cmra += "Camera.sensorWidth: 0.0\n";
+	cmra += "Camera.sensorHeight: 0.0\n";
+
 	cmra += "FileInformation.DateOfCreation: 0.0\n";
 	return cmra;
 }
@@ -303,6 +334,11 @@ bool Camera::write(const std::string &output)
 	temp["Camera.taox"] = this->distortionParams.at<double>(12,0);
 	temp["Camera.taoy"] = this->distortionParams.at<double>(13,0);
 
+	temp["Camera.widthPix"] = this->pixWidth_;
+	temp["Camera.heightPix"] = this->pixHeight_;
+	temp["Camera.sensorWidth"] = this->sensorWidth_;
+	temp["Camera.sensorHeight"] = this->sensorHeight_;
+
 	temp["FileInformation.DateOfCreation"] = str;
 
 	if(fout.is_open() && fout.good()){
@@ -317,8 +353,10 @@ bool Camera::write(const std::string &output)
 	return true;
 }
 
-bool Camera::dumpStats(const std::string &output)
+bool Camera::dumpStats(const std::string &output,
+		const std::vector<std::pair<std::string, std::string>> &extra)
 {
+  computeUncertainties();
 
   const fs::path log_path = output + "/log.csv";
   const fs::path summary_path = output + "/summary.json";
@@ -332,10 +370,13 @@ bool Camera::dumpStats(const std::string &output)
   }
   log << "\n";
 
-  // first write the csv log
+  // first write the csv log, a model without views (loaded or derived)
+  // only gets the header
+  const int nViews = CalibrationStat.rVectors.empty() || !hasUncertainties() ?
+    0 : CalibrationStat.numberSamples;
  
   if(log.is_open() && log.good()){
-    for(int i = 0; i < CalibrationStat.numberSamples; i++){
+    for(int i = 0; i < nViews; i++){
       cv::Mat rot = CalibrationStat.rVectors.at(i);
       cv::Mat tran = CalibrationStat.tVectors.at(i);
       double partRms = CalibrationStat.viewError.at<double>(i, 0);
@@ -346,7 +387,7 @@ bool Camera::dumpStats(const std::string &output)
         << rot.at<double>(2,0) << ','
         << tran.at<double>(0,0) << ',' 
         << tran.at<double>(1,0) << ',' 
-        << tran.at<double>(2,1) << ','
+        << tran.at<double>(2,0) << ','
         << partRms;
 
       for(int j = 0; j < NUMBR_TRANSFORM_STDDEV; j++){
@@ -366,15 +407,21 @@ bool Camera::dumpStats(const std::string &output)
   std::ofstream summary(summary_path);
   if(summary.is_open() && summary.good()){
     summary << '{' << "\n";
-    for(int i = 0; i < CalibrationStat.stdDevIntrinsics.size[0]; i++){
-      if(i ==  CalibrationStat.stdDevIntrinsics.size[0] - 1 ){
-        summary << '"' << distDesc[i] << '"' << " : " 
-          << CalibrationStat.stdDevIntrinsics.at<double>(i,0) << std::endl;
+    const int nIntr = CalibrationStat.stdDevIntrinsics.rows;
+    for(int i = 0; i < nIntr; i++){
+      summary << '"' << distDesc[i] << '"' << " : " 
+        << CalibrationStat.stdDevIntrinsics.at<double>(i,0);
+      if(i < nIntr - 1 || !extra.empty()){
+        summary << ',';
       }
-      else{
-        summary << '"' << distDesc[i] << '"' << " : " 
-          << CalibrationStat.stdDevIntrinsics.at<double>(i,0) << ',' << std::endl;
+      summary << std::endl;
+    }
+    for(size_t i = 0; i < extra.size(); i++){
+      summary << '"' << extra[i].first << '"' << " : " << extra[i].second;
+      if(i < extra.size() - 1){
+        summary << ',';
       }
+      summary << std::endl;
     }
     summary << '}' << "\n";
     summary.close();
@@ -389,8 +436,105 @@ bool Camera::dumpStats(const std::string &output)
 Camera::Camera(const std::string &camName): 
 	intrinsics{cv::Mat::eye(3, 3, CV_64F)},
 	distortionParams{cv::Mat::zeros(14, 1, CV_64F)},
-	name_(camName)
+	thinPrismaModel_(false),
+	rationalModel_(false),
+	tiltedModel_(false),
+	name_(camName),
+	calibrated_(false),
+	aspectRatio_(0.0),
+	focalLength_(0.0),
+	fovx_(0.0),
+	fovy_(0.0),
+	sensorWidth_(0.0),
+	sensorHeight_(0.0),
+	pixWidth_(0.0),
+	pixHeight_(0.0)
 {
+	this->CalibrationStat.numberSamples = 0;
+	this->CalibrationStat.iterations = -1;
+	this->CalibrationStat.uncertaintiesValid = false;
+	this->CalibrationStat.flags = 0;
+}
+
+Camera::Camera(YAML::Node inpt):
+	Camera(inpt["Camera.name"].as<std::string>())
+{
+	this->intrinsics.at<double>(0,0) = inpt["Camera.fx"].as<double>();
+	this->intrinsics.at<double>(1,1) = inpt["Camera.fy"].as<double>();
+	this->intrinsics.at<double>(0,2) = inpt["Camera.cx"].as<double>();
+	this->intrinsics.at<double>(1,2) = inpt["Camera.cy"].as<double>();
+
+	// distDesc holds the key names in distortion parameter order after fx, fy, cx, cy
+	for(int i = 0; i < this->distortionParams.rows; i++){
+		this->distortionParams.at<double>(i,0) = 
+			inpt["Camera." + distDesc[i + 4]].as<double>();
+	}
+
+	auto anyNonZero = [this](int from, int to){
+		for(int i = from; i < to; i++){
+			if(this->distortionParams.at<double>(i,0) != 0.0)
+				return true;
+		}
+		return false;
+	};
+
+	this->rationalModel_ = anyNonZero(5, 8);
+	this->thinPrismaModel_ = anyNonZero(8, 12);
+	this->tiltedModel_ = anyNonZero(12, 14);
+
+	this->pixWidth_ = inpt["Camera.widthPix"].as<double>();
+	this->pixHeight_ = inpt["Camera.heightPix"].as<double>();
+
+	// older camera files have no sensor size
+	this->sensorWidth_ = valueOr<double>(inpt, "Camera.sensorWidth", 0.0);
+	this->sensorHeight_ = valueOr<double>(inpt, "Camera.sensorHeight", 0.0);
+
+	this->calibrated_ = this->intrinsics.at<double>(0,0) > 0.0;
+}
+
+Camera Camera::derive(const std::string &name, const cv::Rect2d &crop,
+		cv::Size size) const
+{
+	Camera out(*this);
+
+	const double sx = size.width / crop.width;
+	const double sy = size.height / crop.height;
+
+	// copies share data with this camera, detach before modifying
+	out.intrinsics = this->intrinsics.clone();
+	out.distortionParams = this->distortionParams.clone();
+
+	// pixel centres: x' + 0.5 = (x + 0.5 - offset) * scale
+	out.intrinsics.at<double>(0,0) = this->intrinsics.at<double>(0,0) * sx;
+	out.intrinsics.at<double>(1,1) = this->intrinsics.at<double>(1,1) * sy;
+	out.intrinsics.at<double>(0,2) = (this->intrinsics.at<double>(0,2) + 0.5 - crop.x) * sx - 0.5;
+	out.intrinsics.at<double>(1,2) = (this->intrinsics.at<double>(1,2) + 0.5 - crop.y) * sy - 0.5;
+
+	out.name_ = name;
+	out.pixWidth_ = size.width;
+	out.pixHeight_ = size.height;
+
+	if(this->pixWidth_ > 0.0 && this->pixHeight_ > 0.0){
+		out.sensorWidth_ = this->sensorWidth_ * crop.width / this->pixWidth_;
+		out.sensorHeight_ = this->sensorHeight_ * crop.height / this->pixHeight_;
+	}
+
+	// per-view results, uncertainties and maps belong to the reference image
+	// geometry, the derived model has no views of its own
+	out.CalibrationStat.rVectors.clear();
+	out.CalibrationStat.tVectors.clear();
+	out.CalibrationStat.viewError.release();
+	out.CalibrationStat.stdDevIntrinsics.release();
+	out.CalibrationStat.stdDeviationExtrinsics.release();
+	out.CalibrationStat.numberSamples = 0;
+	out.CalibrationStat.uncertaintiesValid = false;
+	out.CalibrationStat.worldPoints.clear();
+	out.CalibrationStat.imagePoints.clear();
+	out.undistMap1_.release();
+	out.undistMap2_.release();
+	out.undistMapSize_ = cv::Size();
+
+	return out;
 }
 
 void Camera::print(){
@@ -439,21 +583,206 @@ void Camera::projectPoints(const std::vector<vecp3f> &worldPoints,
 }
 
 
+void Camera::evaluateResiduals(const std::vector<vecp3f> &worldPoints,
+		const std::vector<vecp2f> &imagePoints,
+		Residuals &res) const
+{
+	const size_t nViews = imagePoints.size();
+
+	if(worldPoints.size() != nViews || this->CalibrationStat.rVectors.size() != nViews){
+		throw std::runtime_error("Residuals need the views the camera was calibrated with!\n");
+	}
+
+	// checked up front, the threads below index both vectors by corner
+	res.offsets.resize(nViews + 1);
+	res.offsets[0] = 0;
+	for(size_t i = 0; i < nViews; i++){
+		if(worldPoints[i].size() != imagePoints[i].size()){
+			throw std::runtime_error("View " + std::to_string(i) + " has "
+					+ std::to_string(worldPoints[i].size()) + " board points but "
+					+ std::to_string(imagePoints[i].size()) + " image points!\n");
+		}
+		res.offsets[i + 1] = res.offsets[i] + imagePoints[i].size();
+	}
+
+	// resize keeps the capacity of earlier evaluations
+	res.errors.resize(res.offsets[nViews]);
+	res.norms.resize(res.offsets[nViews]);
+	res.viewRms.resize(nViews);
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(nViews)), [&](const cv::Range &range){
+		vecp2f projected;
+		for(int i = range.start; i < range.end; i++){
+			cv::projectPoints(worldPoints[i],
+					this->CalibrationStat.rVectors[i],
+					this->CalibrationStat.tVectors[i],
+					this->intrinsics,
+					this->distortionParams,
+					projected);
+
+			const size_t off = res.offsets[i];
+			double sq = 0.0;
+
+			for(size_t c = 0; c < projected.size(); c++){
+				const cv::Point2f e = projected[c] - imagePoints[i][c];
+				res.errors[off + c] = e;
+				res.norms[off + c] = std::sqrt(e.dot(e));
+				sq += e.dot(e);
+			}
+
+			res.viewRms[i] = projected.empty() ? 0.0 : std::sqrt(sq / projected.size());
+		}
+	});
+
+	// the heatmap is a single pass over the flat buffers
+	const cv::Size grid = res.heatGrid;
+	res.heatSum.assign(grid.area(), 0.0);
+	res.heatCount.assign(grid.area(), 0);
+	res.maxError = 0.0;
+	double sq = 0.0;
+
+	// cameras loaded from files without an image size span the points instead
+	double width = this->pixWidth_;
+	double height = this->pixHeight_;
+	if(width <= 0.0 || height <= 0.0){
+		width = height = 1.0;
+		for(const auto &view : imagePoints){
+			for(const auto &p : view){
+				width = std::max(width, static_cast<double>(p.x) + 1.0);
+				height = std::max(height, static_cast<double>(p.y) + 1.0);
+			}
+		}
+	}
+
+	for(size_t i = 0; i < nViews; i++){
+		for(size_t c = 0; c < imagePoints[i].size(); c++){
+			const cv::Point2f &p = imagePoints[i][c];
+			const float n = res.norms[res.offsets[i] + c];
+
+			int cx = std::clamp(static_cast<int>(p.x * grid.width / width), 0, grid.width - 1);
+			int cy = std::clamp(static_cast<int>(p.y * grid.height / height), 0, grid.height - 1);
+
+			res.heatSum[cy * grid.width + cx] += n;
+			res.heatCount[cy * grid.width + cx]++;
+			res.maxError = std::max(res.maxError, static_cast<double>(n));
+			sq += n * n;
+		}
+	}
+
+	res.rms = res.corners() > 0 ? std::sqrt(sq / res.corners()) : 0.0;
+}
+
+void Camera::initUndistortMaps(cv::Size imageSize)
+{
+	cv::initUndistortRectifyMap(
+			this->intrinsics,
+			this->distortionParams,
+			cv::noArray(),
+			this->intrinsics,
+			imageSize,
+			CV_16SC2,
+			this->undistMap1_,
+			this->undistMap2_
+			);
+	this->undistMapSize_ = imageSize;
+}
+
+void Camera::undistortImage(const cv::Mat &input, cv::Mat &output) const
+{
+	if(hasUndistortMaps(input.size())){
+		cv::remap(input, output, this->undistMap1_, this->undistMap2_, cv::INTER_LINEAR);
+	}
+	else{
+		cv::undistort(input, output, this->intrinsics, this->distortionParams);
+	}
+}
+
+cv::Mat Camera::undistortImage(const cv::Mat &input) const
+{
+	cv::Mat output;
+	undistortImage(input, output);
+	return output;
+}
+
+vecp2f Camera::undistortPoints(const vecp2f &input) const
+{
+	vecp2f output;
+	if(input.empty()){
+		return output;
+	}
+
+	cv::undistortPoints(input, output, 
+			this->intrinsics, 
+			this->distortionParams, 
+			cv::noArray(), 
+			this->intrinsics);
+	return output;
+}
+
+
 double Camera::calibrate(const std::vector<vecp3f> &worldPoints,
 								const std::vector<vecp2f> &imagePoints,
-								const CalibrationConfig &calibConf)
+								const CalibrationConfig &calibConf,
+								int extraFlags,
+								bool fast)
 {
+	int flags = calibConf.oflags() | extraFlags;
+	const cv::Size imageSize(this->pixWidth_, this->pixHeight_);
+
+	// a warm start already has a better guess than the closed form
+	if(calibConf.initType() == InitType::INIT_ZHANG && !(flags & cv::CALIB_USE_INTRINSIC_GUESS)){
+		ZhangEstimate init;
+		if(zhangInitialize(worldPoints, imagePoints, imageSize, flags, init)){
+			this->intrinsics = init.K;
+			this->distortionParams = cv::Mat::zeros(14, 1, CV_64F);
+			this->CalibrationStat.rVectors = init.rvecs;
+			this->CalibrationStat.tVectors = init.tvecs;
+			flags |= cv::CALIB_USE_INTRINSIC_GUESS;
+			// only the sparse solver takes starting poses
+			if(calibConf.calibType() == CalibType::SPARSE){
+				flags |= cv::CALIB_USE_EXTRINSIC_GUESS;
+			}
+		}
+	}
 
 	this->calibrated_ = true;
 	this->CalibrationStat.numberSamples = imagePoints.size();
+	this->CalibrationStat.iterations = -1;
+	this->CalibrationStat.flags = flags;
+	this->CalibrationStat.uncertaintiesValid = !fast;
+
+	if(fast){
+		this->CalibrationStat.worldPoints = worldPoints;
+		this->CalibrationStat.imagePoints = imagePoints;
+		this->CalibrationStat.stdDevIntrinsics.release();
+		this->CalibrationStat.stdDeviationExtrinsics.release();
+		this->CalibrationStat.viewError.release();
+	}
+	else{
+		this->CalibrationStat.worldPoints.clear();
+		this->CalibrationStat.imagePoints.clear();
+	}
 
 	// TODO: this can be two different functions!
 	switch(calibConf.calibType()){
 		case CalibType::REGULAR:
+			if(fast){
+				return cv::calibrateCamera(
+						worldPoints, 
+						imagePoints, 
+						imageSize, 
+						this->intrinsics, 
+						this->distortionParams, 
+						this->CalibrationStat.rVectors, 
+						this->CalibrationStat.tVectors,
+						flags,
+						calibConf.criteria()
+						);
+			}
 			return cv::calibrateCamera(
 					worldPoints, 
 					imagePoints, 
-					cv::Size(this->pixWidth_, this->pixHeight_), 
+					imageSize, 
 					this->intrinsics, 
 					this->distortionParams, 
 					this->CalibrationStat.rVectors, 
@@ -461,15 +790,30 @@ double Camera::calibrate(const std::vector<vecp3f> &worldPoints,
 					this->CalibrationStat.stdDevIntrinsics, 
 					this->CalibrationStat.stdDeviationExtrinsics, 
 					this->CalibrationStat.viewError, 
-					calibConf.oflags(),
+					flags,
 					calibConf.criteria()
 					);
 			break;
 		case CalibType::RO:
+			if(fast){
+				return cv::calibrateCameraRO(
+						worldPoints, 
+						imagePoints, 
+						imageSize, 
+						calibConf.fixedPoint(),
+						this->intrinsics, 
+						this->distortionParams, 
+						this->CalibrationStat.rVectors, 
+						this->CalibrationStat.tVectors,
+						cv::noArray(),
+						flags,
+						calibConf.criteria()
+						);
+			}
 			return cv::calibrateCameraRO(
 					worldPoints, 
 					imagePoints, 
-					cv::Size(this->pixWidth_, this->pixHeight_), 
+					imageSize, 
 					calibConf.fixedPoint(),
 					this->intrinsics, 
 					this->distortionParams, 
@@ -481,12 +825,60 @@ double Camera::calibrate(const std::vector<vecp3f> &worldPoints,
 					this->CalibrationStat.stdDeviationExtrinsics, 
 					cv::noArray(), // could try to use this later
 					this->CalibrationStat.viewError, 
-					calibConf.oflags(),
+					flags,
 					calibConf.criteria()
 					);
 			break;
+		case CalibType::SPARSE:
+			return calibrateCameraSparse(
+					worldPoints, 
+					imagePoints, 
+					imageSize, 
+					this->intrinsics, 
+					this->distortionParams, 
+					this->CalibrationStat.rVectors, 
+					this->CalibrationStat.tVectors,
+					this->CalibrationStat.stdDevIntrinsics, 
+					this->CalibrationStat.stdDeviationExtrinsics, 
+					this->CalibrationStat.viewError, 
+					flags,
+					calibConf.criteria(),
+					!fast,
+					&this->CalibrationStat.iterations
+					);
+			break;
 		default:
 			throw std::runtime_error("Unknown type");
 			break;
 	}
 }
+
+void Camera::computeUncertainties()
+{
+	if(!this->calibrated_ || this->CalibrationStat.uncertaintiesValid){
+		return;
+	}
+	// loaded or derived models have no views to linearize at
+	if(this->CalibrationStat.rVectors.empty()
+			|| this->CalibrationStat.worldPoints.size() != this->CalibrationStat.rVectors.size()){
+		return;
+	}
+
+	// one linearization at the converged solution, whichever solver found
+	// it; for RO the board is taken as given
+	sparseUncertainties(
+			this->CalibrationStat.worldPoints,
+			this->CalibrationStat.imagePoints,
+			this->intrinsics,
+			this->distortionParams,
+			this->CalibrationStat.rVectors,
+			this->CalibrationStat.tVectors,
+			this->CalibrationStat.flags,
+			this->CalibrationStat.stdDevIntrinsics,
+			this->CalibrationStat.stdDeviationExtrinsics,
+			this->CalibrationStat.viewError);
+
+	this->CalibrationStat.uncertaintiesValid = true;
+	this->CalibrationStat.worldPoints.clear();
+	this->CalibrationStat.imagePoints.clear();
+}
@@ -2,6 +2,8 @@
 #define CAMERACONTAINER_HPP_BZC17YU2
 
 #include <vector>
+#include <string>
+#include <utility>
 #include <functional>
 
 #include <opencv2/core.hpp>
@@ -11,6 +13,8 @@
 
 #include <yaml-cpp/yaml.h>
 
+struct Residuals;
+
 using vecp2f = std::vector<cv::Point2f>;
 using vecp3f = std::vector<cv::Point3f>;
 
@@ -22,9 +26,15 @@ typedef enum {
 
 typedef enum {
 	REGULAR = 0,
-	RO = 1
+	RO = 1,
+	SPARSE = 2
 } CalibType;
 
+typedef enum {
+	INIT_DEFAULT = 0, // whatever the solver does without a guess
+	INIT_ZHANG = 1    // closed form estimate fed in as intrinsic guess
+} InitType;
+
 class CalibrationConfig{
 	public:
 		CalibrationConfig() = delete;
@@ -46,13 +56,13 @@ class CalibrationConfig{
 
 		int fixedPoint() const {return fp;}
 		CalibType calibType() const {return ct;}
+		InitType initType() const {return it;}
 		PointType pointType() const {return pt;}
 		float dim() const {return dimension;}
 
 		cv::TermCriteria criteria() const {return crit;}
 
-		// handle this?
-		cv::Size patternSize(){return ps;}
+		cv::Size patternSize() const {return ps;}
 
 	private:
 
@@ -60,6 +70,7 @@ class CalibrationConfig{
 		int pointFlags;
 		PointType pt;
 		CalibType ct;
+		InitType it;
 		int fp;
 		cv::Size ps;
 
@@ -93,10 +104,25 @@ class Camera {
 		void setPixHeight(double sizeY){pixHeight_ = sizeY;}
 
 		cv::Point2f getPP() const {return principalPoint_;}
+		// empty after a fast calibration until computeUncertainties()
+		const cv::Mat& getViewErrors() const
+		{return CalibrationStat.viewError;}
+		// empty after a fast calibration until computeUncertainties()
+		const cv::Mat& getStdDevIntrinsics() const
+		{return CalibrationStat.stdDevIntrinsics;}
+		int numberSamples() const {return CalibrationStat.numberSamples;}
+		// solver iterations of the last calibration, -1 if the solver does not tell
+		int iterations() const {return CalibrationStat.iterations;}
 
 		void projectPoints(const std::vector<vecp3f> &worldPoints, 
 				std::vector<vecp2f> &projectedPoints);
 
+		// per-corner and per-view reprojection errors of the views the
+		// camera was calibrated with, evaluated in parallel over views
+		void evaluateResiduals(const std::vector<vecp3f> &worldPoints,
+				const std::vector<vecp2f> &imagePoints,
+				Residuals &residuals) const;
+
 		Camera(const std::string &name);
 		/* Camera(): */
 		/* { */
@@ -112,15 +138,44 @@ class Camera {
 		~Camera() = default;
 
 
+		// the same optics seen through another sensor mode: crop is the region
+		// of this camera's image the mode reads out, size the resolution the
+		// mode delivers (binning/scaling). Distortion is unchanged.
+		Camera derive(const std::string &name, const cv::Rect2d &crop,
+				cv::Size size) const;
+
+		const std::string &name() const {return name_;}
+
 		bool write(const std::string &output);
-		bool dumpStats(const std::string &output);
+		// extra entries are appended to summary.json as "key" : value,
+		// values must already be valid json
+		bool dumpStats(const std::string &output,
+				const std::vector<std::pair<std::string, std::string>> &extra = {});
 		void print();
 
+		// extraFlags are or:ed into the configured flags, e.g.
+		// cv::CALIB_USE_INTRINSIC_GUESS to warm start from the current model.
+		// fast skips the standard deviations and per-view errors, for
+		// repeated solves; they are computed from the solution when needed
 		double calibrate(const std::vector<vecp3f> &worldPoints,
 				const std::vector<vecp2f> &imagePoints,
-				const CalibrationConfig &calibConf);
+				const CalibrationConfig &calibConf,
+				int extraFlags = 0,
+				bool fast = false);
+
+		bool hasUncertainties() const {return CalibrationStat.uncertaintiesValid;}
+		// standard deviations and view errors at the current solution,
+		// no-op if the last calibration already has them
+		void computeUncertainties();
+
+		// builds the remap tables for one image size, after that
+		// undistortImage is a single cv::remap and safe to share across threads
+		void initUndistortMaps(cv::Size imageSize);
+		bool hasUndistortMaps(cv::Size imageSize) const
+		{return !undistMap1_.empty() && undistMapSize_ == imageSize;}
 
 		cv::Mat undistortImage(const cv::Mat &input) const;
+		void undistortImage(const cv::Mat &input, cv::Mat &output) const;
 		vecp2f undistortPoints(const vecp2f &input) const;
 
 	private:
@@ -138,6 +193,13 @@ class Camera {
 			std::vector<cv::Mat> rVectors;
 			std::vector<cv::Mat> tVectors;
 			int numberSamples;
+			int iterations;
+
+			// what a fast calibration needs to compute the uncertainties later
+			bool uncertaintiesValid;
+			int flags;
+			std::vector<vecp3f> worldPoints;
+			std::vector<vecp2f> imagePoints;
 
 		} CalibrationStat;
 
@@ -161,6 +223,10 @@ class Camera {
 		double pixWidth_;
 		double pixHeight_;
 		cv::Point2d principalPoint_;
+
+		cv::Size undistMapSize_;
+		cv::Mat undistMap1_;
+		cv::Mat undistMap2_;
 };
 
 #endif /* end of include guard: CAMERACONTAINER_HPP_BZC17YU2 */
@@ -0,0 +1,172 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "utils.hpp"
+#include "circles.hpp"
+
+CircleGridDetector::CircleGridDetector(const YAML::Node &config, cv::Size patternSize,
+		int pointFlags):
+	ps(patternSize),
+	flags(pointFlags),
+	maxSide(valueOr<int>(config, "MaxSide", 0)),
+	refineWindow(valueOr<int>(config, "RefineWindow", 0))
+{
+	params.minThreshold = valueOr<float>(config, "MinThreshold", params.minThreshold);
+	params.maxThreshold = valueOr<float>(config, "MaxThreshold", params.maxThreshold);
+	params.thresholdStep = valueOr<float>(config, "ThresholdStep", params.thresholdStep);
+	params.minRepeatability = valueOr<size_t>(config, "MinRepeatability", params.minRepeatability);
+	params.minDistBetweenBlobs =
+		valueOr<float>(config, "MinDistBetweenBlobs", params.minDistBetweenBlobs);
+
+	params.filterByColor = valueOr<bool>(config, "FilterByColor", params.filterByColor);
+	params.blobColor = static_cast<uchar>(valueOr<int>(config, "BlobColor", params.blobColor));
+
+	params.filterByArea = valueOr<bool>(config, "FilterByArea", params.filterByArea);
+	params.minArea = valueOr<float>(config, "MinArea", params.minArea);
+	params.maxArea = valueOr<float>(config, "MaxArea", params.maxArea);
+
+	params.filterByCircularity =
+		valueOr<bool>(config, "FilterByCircularity", params.filterByCircularity);
+	params.minCircularity = valueOr<float>(config, "MinCircularity", params.minCircularity);
+
+	params.filterByInertia = valueOr<bool>(config, "FilterByInertia", params.filterByInertia);
+	params.minInertiaRatio = valueOr<float>(config, "MinInertiaRatio", params.minInertiaRatio);
+
+	params.filterByConvexity =
+		valueOr<bool>(config, "FilterByConvexity", params.filterByConvexity);
+	params.minConvexity = valueOr<float>(config, "MinConvexity", params.minConvexity);
+
+	if(params.thresholdStep <= 0.0f || params.maxThreshold <= params.minThreshold){
+		throw std::runtime_error("Invalid CircleDetector thresholds!\n");
+	}
+	if(maxSide < 0 || refineWindow < 0){
+		throw std::runtime_error("CircleDetector MaxSide and RefineWindow can't be negative!\n");
+	}
+}
+
+cv::Ptr<cv::FeatureDetector> CircleGridDetector::takeDetector() const
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	if(pool.empty()){
+		return cv::SimpleBlobDetector::create(params);
+	}
+	cv::Ptr<cv::FeatureDetector> det = pool.back();
+	pool.pop_back();
+	return det;
+}
+
+void CircleGridDetector::giveDetector(const cv::Ptr<cv::FeatureDetector> &det) const
+{
+	std::lock_guard<std::mutex> lock(poolMutex);
+	pool.push_back(det);
+}
+
+bool CircleGridDetector::detect(const cv::Mat &image, vecp2f &centers) const
+{
+	const int side = std::max(image.cols, image.rows);
+	const bool downscale = maxSide > 0 && side > maxSide;
+	const double scale = downscale ? static_cast<double>(maxSide) / side : 1.0;
+
+	thread_local cv::Mat small;
+	if(downscale){
+		cv::resize(image, small, cv::Size(), scale, scale, cv::INTER_AREA);
+	}
+
+	// SimpleBlobDetector keeps state while detecting, each call holds its own
+	// one. A detector lost to an exception is simply not returned to the pool
+	const cv::Ptr<cv::FeatureDetector> det = takeDetector();
+	const bool found = cv::findCirclesGrid(downscale ? small : image, ps, centers, flags, det);
+	giveDetector(det);
+
+	if(!found || !downscale){
+		return found;
+	}
+
+	// pixel centres of the downscaled image back to full resolution
+	for(auto &c : centers){
+		c.x = static_cast<float>((c.x + 0.5) / scale - 0.5);
+		c.y = static_cast<float>((c.y + 0.5) / scale - 0.5);
+	}
+
+	refine(image, centers);
+	return true;
+}
+
+void CircleGridDetector::refine(const cv::Mat &image, vecp2f &centers) const
+{
+	// frames are 8 bit gray everywhere, anything else keeps the mapped centres
+	if(image.type() != CV_8UC1){
+		return;
+	}
+
+	int half = refineWindow;
+	if(half == 0){
+		// well inside the gap to the neighbouring circles
+		thread_local std::vector<float> dists;
+		dists.clear();
+		for(size_t i = 0; i + 1 < centers.size(); i++){
+			if((i + 1) % ps.width != 0){
+				const cv::Point2f d = centers[i + 1] - centers[i];
+				dists.push_back(std::hypot(d.x, d.y));
+			}
+		}
+		if(dists.empty()){
+			return;
+		}
+		std::nth_element(dists.begin(), dists.begin() + dists.size() / 2, dists.end());
+		half = std::max(3, static_cast<int>(0.3 * dists[dists.size() / 2]));
+	}
+
+	const bool dark = params.blobColor == 0;
+	const cv::Rect bounds(0, 0, image.cols, image.rows);
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(centers.size())), [&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			cv::Point2f c = centers[i];
+
+			// twice, the second pass is centred on the first estimate
+			for(int pass = 0; pass < 2; pass++){
+				const cv::Rect win = cv::Rect(static_cast<int>(std::lround(c.x)) - half,
+						static_cast<int>(std::lround(c.y)) - half,
+						2 * half + 1, 2 * half + 1) & bounds;
+				if(win.area() == 0){
+					break;
+				}
+
+				const cv::Mat roi = image(win);
+				double lo, hi;
+				cv::minMaxLoc(roi, &lo, &hi);
+				const double threshold = 0.5 * (lo + hi);
+
+				double sw = 0.0, sx = 0.0, sy = 0.0;
+				for(int y = 0; y < roi.rows; y++){
+					const uchar *row = roi.ptr<uchar>(y);
+					for(int x = 0; x < roi.cols; x++){
+						const double w = dark ? threshold - row[x] : row[x] - threshold;
+						if(w > 0.0){
+							sw += w;
+							sx += w * (win.x + x);
+							sy += w * (win.y + y);
+						}
+					}
+				}
+				if(sw <= 0.0){
+					break;
+				}
+				c = cv::Point2f(static_cast<float>(sx / sw), static_cast<float>(sy / sw));
+			}
+
+			centers[i] = c;
+		}
+	});
+}
@@ -0,0 +1,70 @@
+#ifndef CIRCLES_HPP_G6PH1RZY
+#define CIRCLES_HPP_G6PH1RZY
+
+#include <vector>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+
+/*
+ * Circle grid detection with a configurable blob detector. Concurrent
+ * detect() calls each take a detector from a pool the instance owns, so
+ * one CircleGridDetector can back findPoints for parallel detection.
+ * Optionally detects on a downscaled copy and refines every centre on the
+ * full resolution image with an intensity weighted centroid.
+ *
+ * Configured from the optional "CircleDetector" section of the calibration
+ * yml, blob parameters default to cv::SimpleBlobDetector's and apply to the
+ * image detection runs on (the downscaled one when MaxSide is set):
+ *
+ *   CircleDetector:
+ *     MaxSide: 1600           # detect at this longest side, 0 = full size
+ *     RefineWindow: 0         # refine half window in pixels, 0 = from spacing
+ *     MinThreshold: 50
+ *     MaxThreshold: 220
+ *     ThresholdStep: 10       # fewer steps detect faster
+ *     MinRepeatability: 2
+ *     MinDistBetweenBlobs: 10
+ *     BlobColor: 0            # 0 dark circles, 255 light
+ *     MinArea: 25
+ *     MaxArea: 5000
+ *     MinCircularity: 0.8     # FilterByCircularity, FilterByInertia and
+ *     MinInertiaRatio: 0.1    # FilterByConvexity switch these filters
+ *     MinConvexity: 0.95
+ */
+class CircleGridDetector {
+	public:
+		CircleGridDetector() = delete;
+
+		CircleGridDetector(const YAML::Node &config, cv::Size patternSize, int flags);
+
+		CircleGridDetector(const CircleGridDetector &other) = delete;
+		CircleGridDetector &operator=(const CircleGridDetector &other) = delete;
+
+		~CircleGridDetector() = default;
+
+		bool detect(const cv::Mat &image, vecp2f &centers) const;
+
+	private:
+
+		cv::Ptr<cv::FeatureDetector> takeDetector() const;
+		void giveDetector(const cv::Ptr<cv::FeatureDetector> &det) const;
+		void refine(const cv::Mat &image, vecp2f &centers) const;
+
+		cv::SimpleBlobDetector::Params params;
+		cv::Size ps;
+		int flags;
+		int maxSide;
+		int refineWindow;
+
+		// idle detectors, at most one per thread that detected at once
+		mutable std::mutex poolMutex;
+		mutable std::vector<cv::Ptr<cv::FeatureDetector>> pool;
+};
+
+#endif /* end of include guard: CIRCLES_HPP_G6PH1RZY */
@@ -0,0 +1,132 @@
+#include <array>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "utils.hpp"
+#include "coverage.hpp"
+
+CoverageMap::CoverageMap(const YAML::Node &config):
+	minHitsPerCell(valueOr<int>(config, "MinHitsPerCell", 1)),
+	targetCoverage(valueOr<double>(config, "TargetCoverage", 0.85)),
+	tiltBinDegrees(valueOr<double>(config, "TiltBinDegrees", 10.0)),
+	minViewsPerTiltBin(valueOr<int>(config, "MinViewsPerTiltBin", 2)),
+	minTiltBins(valueOr<int>(config, "MinTiltBins", 3)),
+	minViews(valueOr<int>(config, "MinViews", 10)),
+	earlyStop_(valueOr<bool>(config, "EarlyStop", false)),
+	views_(0)
+{
+	std::array<int, 2> size = valueOr<std::array<int, 2>>(config, "GridSize", {8, 6});
+	grid = cv::Size(size[0], size[1]);
+
+	if(grid.width <= 0 || grid.height <= 0 || tiltBinDegrees <= 0.0){
+		throw std::runtime_error("Coverage grid and tilt bins must be positive!\n");
+	}
+
+	cells.assign(grid.area(), 0);
+	tiltHistogram.assign(static_cast<int>(std::ceil(90.0 / tiltBinDegrees)), 0);
+}
+
+void CoverageMap::add(const vecp2f &corners, const vecp3f &board, cv::Size imageSize)
+{
+	for(const auto &c : corners){
+		int cx = std::clamp(static_cast<int>(c.x * grid.width / imageSize.width), 0, grid.width - 1);
+		int cy = std::clamp(static_cast<int>(c.y * grid.height / imageSize.height), 0, grid.height - 1);
+		cells[cy * grid.width + cx]++;
+	}
+
+	double tilt = boardTilt(corners, board, imageSize);
+	int bin = std::min(static_cast<int>(tilt / tiltBinDegrees),
+			static_cast<int>(tiltHistogram.size()) - 1);
+	tiltHistogram[bin]++;
+
+	views_++;
+}
+
+// angle between board normal and optical axis in degrees, from the
+// homography with a nominal pinhole guess (f = largest image side)
+double CoverageMap::boardTilt(const vecp2f &corners, const vecp3f &board,
+		cv::Size imageSize)
+{
+	plane.resize(board.size());
+	for(size_t i = 0; i < board.size(); i++){
+		plane[i] = cv::Point2f(board[i].x, board[i].y);
+	}
+
+	cv::Mat H = cv::findHomography(plane, corners);
+	if(H.empty()){
+		return 0.0;
+	}
+
+	const double f = std::max(imageSize.width, imageSize.height);
+	cv::Matx33d Kinv(1.0 / f, 0.0, -0.5 * imageSize.width / f,
+			0.0, 1.0 / f, -0.5 * imageSize.height / f,
+			0.0, 0.0, 1.0);
+	cv::Matx33d Hn = Kinv * cv::Matx33d(H);
+
+	cv::Vec3d r1(Hn(0,0), Hn(1,0), Hn(2,0));
+	cv::Vec3d r2(Hn(0,1), Hn(1,1), Hn(2,1));
+	cv::Vec3d n = r1.cross(r2);
+
+	double len = cv::norm(n);
+	if(len == 0.0){
+		return 0.0;
+	}
+
+	return std::acos(std::min(1.0, std::abs(n[2]) / len)) * 180.0 / CV_PI;
+}
+
+double CoverageMap::coverage() const
+{
+	int covered = 0;
+	for(int hits : cells){
+		covered += hits >= minHitsPerCell ? 1 : 0;
+	}
+	return static_cast<double>(covered) / cells.size();
+}
+
+int CoverageMap::tiltBinsFilled() const
+{
+	int filled = 0;
+	for(int n : tiltHistogram){
+		filled += n >= minViewsPerTiltBin ? 1 : 0;
+	}
+	return filled;
+}
+
+bool CoverageMap::targetsMet() const
+{
+	return views_ >= minViews
+		&& coverage() >= targetCoverage
+		&& tiltBinsFilled() >= minTiltBins;
+}
+
+std::string CoverageMap::toJson() const
+{
+	std::ostringstream js;
+
+	js << "{\"views\" : " << views_
+		<< ", \"grid\" : [" << grid.width << ", " << grid.height << "]"
+		<< ", \"coverage\" : " << coverage()
+		<< ", \"tilt_bins_filled\" : " << tiltBinsFilled()
+		<< ", \"targets_met\" : " << (targetsMet() ? "true" : "false");
+
+	js << ", \"cells\" : [";
+	for(size_t i = 0; i < cells.size(); i++){
+		js << (i ? ", " : "") << cells[i];
+	}
+
+	js << "], \"tilt_bin_degrees\" : " << tiltBinDegrees
+		<< ", \"tilt_histogram\" : [";
+	for(size_t i = 0; i < tiltHistogram.size(); i++){
+		js << (i ? ", " : "") << tiltHistogram[i];
+	}
+	js << "]}";
+
+	return js.str();
+}
@@ -0,0 +1,72 @@
+#ifndef COVERAGE_HPP_R5TN2EVB
+#define COVERAGE_HPP_R5TN2EVB
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+
+/*
+ * Incremental record of where detected corners land in the image and how
+ * tilted the board was, updated for every successful detection. Used to
+ * decide when enough views have been collected.
+ *
+ * Configured from the optional "Coverage" section of the calibration yml:
+ *
+ *   Coverage:
+ *     GridSize: [8, 6]          # cells over the image
+ *     MinHitsPerCell: 1         # corners needed for a cell to count
+ *     TargetCoverage: 0.85      # fraction of cells that must be covered
+ *     TiltBinDegrees: 10        # width of the board tilt histogram bins
+ *     MinViewsPerTiltBin: 2
+ *     MinTiltBins: 3            # distinct tilts needed
+ *     MinViews: 10
+ *     EarlyStop: true           # stop ingesting once all targets are met
+ */
+class CoverageMap {
+	public:
+		CoverageMap() = delete;
+
+		CoverageMap(const YAML::Node &config);
+
+		~CoverageMap() = default;
+
+		// corners and the matching board coordinates of one detection
+		void add(const vecp2f &corners, const vecp3f &board, cv::Size imageSize);
+
+		double coverage() const;
+		int tiltBinsFilled() const;
+		int views() const {return views_;}
+
+		bool targetsMet() const;
+		bool earlyStop() const {return earlyStop_;}
+
+		// json object for summary.json
+		std::string toJson() const;
+
+	private:
+
+		double boardTilt(const vecp2f &corners, const vecp3f &board,
+				cv::Size imageSize);
+
+		cv::Size grid;
+		int minHitsPerCell;
+		double targetCoverage;
+		double tiltBinDegrees;
+		int minViewsPerTiltBin;
+		int minTiltBins;
+		int minViews;
+		bool earlyStop_;
+
+		std::vector<int> cells;
+		std::vector<int> tiltHistogram;
+		int views_;
+
+		vecp2f plane; // board in its own plane, reused between views
+};
+
+#endif /* end of include guard: COVERAGE_HPP_R5TN2EVB */
@@ -0,0 +1,153 @@
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include <opencv2/core.hpp>
+
+#include "detections.hpp"
+
+void DetectionSet::add(int index, const std::string &label, const vecp2f &found)
+{
+	if(static_cast<int>(found.size()) != patternSize.area()){
+		throw std::runtime_error("Detection of " + label + " does not match the pattern size!\n");
+	}
+	indices.push_back(index);
+	labels.push_back(label);
+	corners.push_back(found);
+}
+
+void DetectionSet::write(const std::string &path) const
+{
+	// checked before the file is created, a short row would be padded with
+	// whatever the packed matrix held
+	const int n = patternSize.area();
+	for(size_t v = 0; v < corners.size(); v++){
+		if(corners[v].size() != static_cast<size_t>(n)){
+			throw std::runtime_error("View " + std::to_string(v) + " has "
+					+ std::to_string(corners[v].size()) + " corners, the pattern "
+					+ std::to_string(n) + "!\n");
+		}
+	}
+
+	cv::FileStorage fs(path, cv::FileStorage::WRITE | cv::FileStorage::BASE64);
+	if(!fs.isOpened()){
+		throw std::runtime_error("Unable to write detections to " + path + "\n");
+	}
+
+	// one row of interleaved x, y per view
+	cv::Mat packed(static_cast<int>(corners.size()), 2 * n, CV_32F);
+	for(size_t v = 0; v < corners.size(); v++){
+		cv::Mat(corners[v]).reshape(1, 1).copyTo(packed.row(static_cast<int>(v)));
+	}
+
+	fs << "image_size" << imageSize;
+	fs << "pattern_size" << patternSize;
+	fs << "square_size" << squareSize;
+	fs << "shard_index" << shardIndex;
+	fs << "shard_count" << shardCount;
+	fs << "frames_processed" << framesProcessed;
+	fs << "indices" << indices;
+	fs << "labels" << labels;
+	fs << "corners" << packed;
+}
+
+DetectionSet DetectionSet::read(const std::string &path)
+{
+	cv::FileStorage fs(path, cv::FileStorage::READ);
+	if(!fs.isOpened()){
+		throw std::runtime_error("Unable to read detections from " + path + "\n");
+	}
+
+	DetectionSet set;
+	cv::Mat packed;
+
+	fs["image_size"] >> set.imageSize;
+	fs["pattern_size"] >> set.patternSize;
+	fs["square_size"] >> set.squareSize;
+	fs["shard_index"] >> set.shardIndex;
+	fs["shard_count"] >> set.shardCount;
+	fs["frames_processed"] >> set.framesProcessed;
+	fs["indices"] >> set.indices;
+	fs["labels"] >> set.labels;
+	fs["corners"] >> packed;
+
+	const int n = set.patternSize.area();
+	if(set.indices.size() != set.labels.size()
+			|| (!packed.empty() && (packed.rows != static_cast<int>(set.indices.size())
+					|| packed.cols != 2 * n))
+			|| (packed.empty() && !set.indices.empty())){
+		throw std::runtime_error(path + " is not a valid detection file!\n");
+	}
+
+	set.corners.resize(set.indices.size());
+	for(int v = 0; v < packed.rows; v++){
+		packed.row(v).reshape(2, n).copyTo(set.corners[v]);
+	}
+
+	return set;
+}
+
+DetectionSet DetectionSet::merge(const std::vector<std::string> &paths)
+{
+	if(paths.empty()){
+		throw std::runtime_error("Nothing to merge!\n");
+	}
+
+	DetectionSet merged;
+	std::vector<bool> seen;
+
+	for(size_t k = 0; k < paths.size(); k++){
+		DetectionSet shard = read(paths[k]);
+
+		if(k == 0){
+			merged.imageSize = shard.imageSize;
+			merged.patternSize = shard.patternSize;
+			merged.squareSize = shard.squareSize;
+			merged.shardCount = shard.shardCount;
+			seen.assign(std::max(1, shard.shardCount), false);
+		}
+		else if((!shard.imageSize.empty() && !merged.imageSize.empty()
+					&& shard.imageSize != merged.imageSize)
+				|| shard.patternSize != merged.patternSize
+				|| std::abs(shard.squareSize - merged.squareSize) > 1e-9
+				|| shard.shardCount != merged.shardCount){
+			throw std::runtime_error(paths[k] + " does not belong to the same run as "
+					+ paths[0] + "\n");
+		}
+
+		if(shard.shardIndex < 0 || shard.shardIndex >= static_cast<int>(seen.size())
+				|| seen[shard.shardIndex]){
+			throw std::runtime_error(paths[k] + " repeats or has an invalid shard index!\n");
+		}
+		seen[shard.shardIndex] = true;
+
+		// a shard that read no image knows no image size
+		if(merged.imageSize.empty()){
+			merged.imageSize = shard.imageSize;
+		}
+
+		merged.framesProcessed += shard.framesProcessed;
+		merged.indices.insert(merged.indices.end(), shard.indices.begin(), shard.indices.end());
+		merged.labels.insert(merged.labels.end(), shard.labels.begin(), shard.labels.end());
+		merged.corners.insert(merged.corners.end(), shard.corners.begin(), shard.corners.end());
+	}
+
+	// back into input order
+	std::vector<size_t> order(merged.indices.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+			[&](size_t a, size_t b){return merged.indices[a] < merged.indices[b];});
+
+	DetectionSet sorted = merged;
+	for(size_t i = 0; i < order.size(); i++){
+		sorted.indices[i] = merged.indices[order[i]];
+		sorted.labels[i] = merged.labels[order[i]];
+		sorted.corners[i] = merged.corners[order[i]];
+	}
+	sorted.shardIndex = 0;
+
+	return sorted;
+}
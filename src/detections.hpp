@@ -0,0 +1,42 @@
+#ifndef DETECTIONS_HPP_N8CB3KUF
+#define DETECTIONS_HPP_N8CB3KUF
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "camera.hpp"
+
+/*
+ * Accepted detections of one calibration run or of one shard of it, so
+ * detection can be spread over processes and machines with plain files in
+ * between. Every view keeps its position in the full, deterministically
+ * ordered input, merged shards come out in input order no matter how the
+ * work was split. Stored with cv::FileStorage, corners as one base64
+ * encoded matrix; a .gz suffix compresses the file.
+ */
+struct DetectionSet {
+	cv::Size imageSize;
+	cv::Size patternSize;
+	double squareSize = 0.0;
+	int shardIndex = 0;
+	int shardCount = 1;
+	int framesProcessed = 0;
+
+	std::vector<int> indices;         // position in the full input
+	std::vector<std::string> labels;
+	std::vector<vecp2f> corners;
+
+	void add(int index, const std::string &label, const vecp2f &found);
+	size_t views() const {return corners.size();}
+
+	void write(const std::string &path) const;
+	static DetectionSet read(const std::string &path);
+
+	// shards of the same run, views ordered by input position; throws if
+	// the shards disagree on image, pattern or square size
+	static DetectionSet merge(const std::vector<std::string> &paths);
+};
+
+#endif /* end of include guard: DETECTIONS_HPP_N8CB3KUF */
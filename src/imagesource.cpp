@@ -0,0 +1,394 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cctype>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "imagesource.hpp"
+
+namespace fs = std::filesystem;
+
+cv::Mat FramePool::take()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if(free.empty()){
+		return cv::Mat();
+	}
+	cv::Mat image = free.back();
+	free.pop_back();
+	return image;
+}
+
+void FramePool::give(const cv::Mat &image)
+{
+	// a consumer that kept a header to the frame still reads it, the buffer
+	// is only reused once the caller's is the last reference
+	if(image.empty() || !image.u || image.u->refcount != 1){
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mtx);
+	free.push_back(image);
+}
+
+bool readFile(const std::string &path, std::vector<uchar> &bytes)
+{
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if(!in.is_open()){
+		return false;
+	}
+
+	const std::streamsize size = in.tellg();
+	if(size <= 0){
+		return false;
+	}
+	in.seekg(0);
+
+	bytes.resize(static_cast<size_t>(size));
+	return static_cast<bool>(in.read(reinterpret_cast<char *>(bytes.data()), size));
+}
+
+FileSource::FileSource(const std::vector<std::string> &inputFiles,
+		int threads, size_t memoryBudget):
+	files(inputFiles),
+	nextClaim(0),
+	nextOut(0),
+	bytesBuffered(0),
+	budget(memoryBudget),
+	stopping(false)
+{
+	for(int i = 0; i < std::max(1, threads); i++){
+		workers.emplace_back(&FileSource::worker, this);
+	}
+}
+
+FileSource::~FileSource()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	consumed.notify_all();
+	produced.notify_all();
+
+	for(auto &w : workers){
+		w.join();
+	}
+}
+
+void FileSource::worker()
+{
+	std::vector<uchar> bytes;
+
+	while(true){
+		size_t idx;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			// always allow the frame the consumer waits for, otherwise respect the budget
+			consumed.wait(lock, [this]{
+					return stopping || nextClaim >= files.size()
+						|| nextClaim == nextOut || bytesBuffered < budget;
+					});
+
+			if(stopping || nextClaim >= files.size()){
+				return;
+			}
+			idx = nextClaim++;
+		}
+
+		Frame frame;
+		frame.index = idx;
+		frame.label = files[idx];
+		// decode into a recycled buffer, it is reused when the size matches
+		frame.image = pool.take();
+		if(!readFile(files[idx], bytes)
+				|| cv::imdecode(bytes, cv::IMREAD_GRAYSCALE, &frame.image).empty()){
+			frame.image.release();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			bytesBuffered += frame.image.total() * frame.image.elemSize();
+			ready.emplace(idx, std::move(frame));
+		}
+		produced.notify_all();
+	}
+}
+
+bool FileSource::next(Frame &frame)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	if(nextOut >= files.size()){
+		return false;
+	}
+
+	produced.wait(lock, [this]{return stopping || ready.count(nextOut) > 0;});
+	if(stopping){
+		return false;
+	}
+
+	auto it = ready.find(nextOut);
+	frame = std::move(it->second);
+	ready.erase(it);
+	nextOut++;
+
+	// the consumer is done with the previous frame
+	pool.give(lastOut);
+	lastOut = frame.image;
+
+	bytesBuffered -= frame.image.total() * frame.image.elemSize();
+	lock.unlock();
+
+	consumed.notify_all();
+	return true;
+}
+
+std::vector<std::string> FileSource::listDirectory(const std::string &dir)
+{
+	std::vector<std::string> paths;
+
+	for(const auto &en : fs::directory_iterator(dir)){
+		if(en.is_regular_file()){
+			paths.push_back(en.path().string());
+		}
+	}
+
+	// directory_iterator order is unspecified
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+std::vector<std::string> FileSource::readManifest(const std::string &manifest)
+{
+	std::ifstream in(manifest);
+	if(!in.is_open()){
+		throw std::runtime_error("Unable to open manifest " + manifest + "\n");
+	}
+
+	const fs::path base = fs::path(manifest).parent_path();
+	std::vector<std::string> paths;
+	std::string line;
+
+	while(std::getline(in, line)){
+		line.erase(0, line.find_first_not_of(" \t"));
+		line.erase(line.find_last_not_of(" \t\r") + 1);
+
+		if(line.empty() || line[0] == '#'){
+			continue;
+		}
+
+		fs::path p(line);
+		paths.push_back(p.is_absolute() ? p.string() : (base / p).string());
+	}
+
+	return paths;
+}
+
+
+static cv::VideoCapture openCapture(const std::string &source)
+{
+	cv::VideoCapture cap;
+
+	if(!source.empty() && std::all_of(source.begin(), source.end(),
+				[](unsigned char c){return std::isdigit(c);})){
+		cap.open(std::stoi(source));
+	}
+	else{
+		cap.open(source);
+	}
+
+	if(!cap.isOpened()){
+		throw std::runtime_error("Unable to open " + source + "\n");
+	}
+
+	return cap;
+}
+
+static size_t framesInBudget(const cv::VideoCapture &cap, size_t memoryBudget)
+{
+	const double frameBytes = cap.get(cv::CAP_PROP_FRAME_WIDTH) * cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+	if(frameBytes <= 0.0){
+		return 2;
+	}
+	return std::max<size_t>(1, static_cast<size_t>(memoryBudget / frameBytes));
+}
+
+VideoSource::VideoSource(const std::string &source, size_t memoryBudget):
+	cap(openCapture(source)),
+	frames(framesInBudget(cap, memoryBudget))
+{
+	decoder = std::thread(&VideoSource::decode, this);
+}
+
+VideoSource::~VideoSource()
+{
+	frames.close();
+	decoder.join();
+}
+
+void VideoSource::decode()
+{
+	cv::Mat raw;
+	size_t idx = 0;
+
+	while(cap.read(raw)){
+		Frame frame;
+		frame.index = idx;
+		frame.label = "frame " + std::to_string(idx);
+		idx++;
+
+		frame.image = pool.take();
+		if(raw.channels() == 3){
+			cv::cvtColor(raw, frame.image, cv::COLOR_BGR2GRAY);
+		}
+		else{
+			raw.copyTo(frame.image);
+		}
+
+		if(!frames.push(std::move(frame))){
+			break;
+		}
+	}
+
+	frames.close();
+}
+
+bool VideoSource::next(Frame &frame)
+{
+	// the consumer is done with the previous frame, frame is overwritten
+	// anyway and must not keep the buffer from being recycled
+	frame.image.release();
+	pool.give(lastOut);
+	lastOut.release();
+
+	if(!frames.pop(frame)){
+		return false;
+	}
+	lastOut = frame.image;
+	return true;
+}
+
+
+RawStdinSource::RawStdinSource(int width, int height):
+	idx(0)
+{
+	if(width <= 0 || height <= 0){
+		throw std::runtime_error("Raw frames need a positive width and height!\n");
+	}
+	buffer.create(height, width, CV_8UC1);
+}
+
+bool RawStdinSource::next(Frame &frame)
+{
+	const size_t bytes = buffer.total();
+	const size_t got = std::fread(buffer.data, 1, bytes, stdin);
+
+	if(got != bytes){
+		if(got != 0){
+			std::fprintf(stderr, "stdin ended inside frame %zu, dropped\n", idx);
+		}
+		return false;
+	}
+
+	frame.index = idx;
+	frame.label = "frame " + std::to_string(idx);
+	frame.image = buffer;
+	idx++;
+	return true;
+}
+
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+		"the ring counters are shared between processes");
+
+ShmRingSource::ShmRingSource(const std::string &shmName, int width, int height):
+	name(shmName),
+	mapping(MAP_FAILED),
+	mappedBytes(0),
+	header(nullptr),
+	data(nullptr),
+	frameBytes(static_cast<size_t>(width) * height),
+	idx(0)
+{
+	if(width <= 0 || height <= 0){
+		throw std::runtime_error("Raw frames need a positive width and height!\n");
+	}
+
+	const int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if(fd < 0){
+		throw std::runtime_error("Unable to open shared memory " + name + "\n");
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= ShmRingHeader::dataOffset){
+		mappedBytes = st.st_size;
+		mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	if(mapping == MAP_FAILED){
+		throw std::runtime_error("Unable to map shared memory " + name + "\n");
+	}
+
+	header = static_cast<ShmRingHeader *>(mapping);
+	data = static_cast<uint8_t *>(mapping) + ShmRingHeader::dataOffset;
+
+	if(header->magic != ShmRingHeader::MAGIC
+			|| header->width != static_cast<uint32_t>(width)
+			|| header->height != static_cast<uint32_t>(height)
+			|| header->slots == 0
+			|| ShmRingHeader::dataOffset + header->slots * frameBytes > mappedBytes){
+		munmap(mapping, mappedBytes);
+		throw std::runtime_error("Shared memory " + name
+				+ " is not a ring of " + std::to_string(width) + "x"
+				+ std::to_string(height) + " frames!\n");
+	}
+
+	// start at the oldest frame still in the ring
+	const uint64_t written = header->written.load(std::memory_order_acquire);
+	idx = written > header->slots ? written - header->slots : 0;
+}
+
+ShmRingSource::~ShmRingSource()
+{
+	// release every slot, the producer must not block on a gone consumer
+	header->consumed.store(header->written.load(std::memory_order_acquire),
+			std::memory_order_release);
+	munmap(mapping, mappedBytes);
+}
+
+bool ShmRingSource::next(Frame &frame)
+{
+	// the previous frame is done with, its slot may be refilled
+	header->consumed.store(idx, std::memory_order_release);
+
+	while(header->written.load(std::memory_order_acquire) <= idx){
+		if(header->closed.load(std::memory_order_acquire)
+				&& header->written.load(std::memory_order_acquire) <= idx){
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	frame.index = idx;
+	frame.label = "frame " + std::to_string(idx);
+	frame.image = cv::Mat(header->height, header->width, CV_8UC1,
+			data + (idx % header->slots) * frameBytes);
+	idx++;
+	return true;
+}
@@ -0,0 +1,194 @@
+#ifndef IMAGESOURCE_HPP_P6VE1XKA
+#define IMAGESOURCE_HPP_P6VE1XKA
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "queue.hpp"
+
+struct Frame {
+	std::string label;
+	size_t index = 0;
+	cv::Mat image; // 8 bit grayscale, empty if it could not be decoded
+};
+
+// whole file into bytes, reusing their capacity; false if unreadable
+bool readFile(const std::string &path, std::vector<uchar> &bytes);
+
+/*
+ * Frame buffers handed back by the consumer for the producer to decode the
+ * next frames into, so steady state decoding does not allocate. Only
+ * buffers no one else holds a reference to are kept.
+ */
+class FramePool {
+	public:
+		// a recycled buffer, empty if none is free
+		cv::Mat take();
+		void give(const cv::Mat &image);
+
+	private:
+		std::mutex mtx;
+		std::vector<cv::Mat> free;
+};
+
+class ImageSource {
+	public:
+		virtual ~ImageSource() = default;
+
+		// blocks until the next frame is available, false at the end. The
+		// image may point into memory owned by the source and is only valid
+		// until the following call to next(), which may decode the next frame
+		// into the same buffer. clone() it to keep it longer
+		virtual bool next(Frame &frame) = 0;
+};
+
+/*
+ * Images from a fixed, ordered list of files. Background threads read and
+ * decode ahead of the consumer while the decoded-but-unconsumed frames stay
+ * below memoryBudget bytes, frames are handed out strictly in list order.
+ */
+class FileSource : public ImageSource {
+	public:
+		FileSource(const std::vector<std::string> &files,
+				int threads, size_t memoryBudget);
+
+		FileSource(const FileSource &other) = delete;
+		FileSource &operator=(const FileSource &other) = delete;
+
+		~FileSource() override;
+
+		bool next(Frame &frame) override;
+
+		size_t size() const {return files.size();}
+
+		// regular files in dir, sorted by path
+		static std::vector<std::string> listDirectory(const std::string &dir);
+		// one path per line, relative paths are relative to the manifest
+		static std::vector<std::string> readManifest(const std::string &manifest);
+
+	private:
+
+		void worker();
+
+		std::vector<std::string> files;
+		FramePool pool;
+		cv::Mat lastOut;
+		std::vector<std::thread> workers;
+
+		std::mutex mtx;
+		std::condition_variable produced;
+		std::condition_variable consumed;
+
+		std::map<size_t, Frame> ready;
+		size_t nextClaim;
+		size_t nextOut;
+		size_t bytesBuffered;
+		const size_t budget;
+		bool stopping;
+};
+
+/*
+ * Frames from a video file, stream url or capture device index (all
+ * digits), decoded on a background thread into a bounded queue.
+ */
+class VideoSource : public ImageSource {
+	public:
+		VideoSource(const std::string &source, size_t memoryBudget);
+
+		VideoSource(const VideoSource &other) = delete;
+		VideoSource &operator=(const VideoSource &other) = delete;
+
+		~VideoSource() override;
+
+		bool next(Frame &frame) override;
+
+	private:
+
+		void decode();
+
+		cv::VideoCapture cap;
+		FramePool pool;
+		cv::Mat lastOut;
+		BoundedQueue<Frame> frames;
+		std::thread decoder;
+};
+
+/*
+ * Fixed size raw 8 bit grayscale frames (a Y plane, width*height bytes, no
+ * header) back to back on stdin. Each frame is read straight into one
+ * buffer the frame image wraps.
+ */
+class RawStdinSource : public ImageSource {
+	public:
+		RawStdinSource(int width, int height);
+
+		RawStdinSource(const RawStdinSource &other) = delete;
+		RawStdinSource &operator=(const RawStdinSource &other) = delete;
+
+		~RawStdinSource() override = default;
+
+		bool next(Frame &frame) override;
+
+	private:
+
+		cv::Mat buffer;
+		size_t idx;
+};
+
+/*
+ * Layout of the shared memory ring written by the capture pipeline. The
+ * header is followed, at dataOffset, by slots frames of width*height bytes,
+ * frame n lives in slot n % slots. The producer fills a slot, then
+ * increments written. It may only write frame n once n < consumed + slots,
+ * consumed is the frame the calibrator is working on. Setting closed ends
+ * the stream after the written frames.
+ */
+struct ShmRingHeader {
+	static constexpr uint32_t MAGIC = 0x474e5243; // "CRNG"
+	static constexpr size_t dataOffset = 4096;
+
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t slots;
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> consumed;
+	std::atomic<uint32_t> closed;
+};
+
+/*
+ * Frames from a POSIX shared memory ring (see ShmRingHeader), handed out as
+ * headers over the mapped slot, nothing is copied.
+ */
+class ShmRingSource : public ImageSource {
+	public:
+		ShmRingSource(const std::string &name, int width, int height);
+
+		ShmRingSource(const ShmRingSource &other) = delete;
+		ShmRingSource &operator=(const ShmRingSource &other) = delete;
+
+		~ShmRingSource() override;
+
+		bool next(Frame &frame) override;
+
+	private:
+
+		std::string name;
+		void *mapping;
+		size_t mappedBytes;
+		ShmRingHeader *header;
+		uint8_t *data;
+		size_t frameBytes;
+		uint64_t idx;
+};
+
+#endif /* end of include guard: IMAGESOURCE_HPP_P6VE1XKA */
@@ -0,0 +1,180 @@
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <bitset>
+#include <array>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "utils.hpp"
+#include "prefilter.hpp"
+
+using clk = std::chrono::steady_clock;
+
+BlurFilter::BlurFilter(const YAML::Node &config):
+	enabled_(valueOr<bool>(config, "Enabled", false)),
+	maxSide(valueOr<int>(config, "MaxSide", 640)),
+	minVariance(valueOr<double>(config, "MinLaplacianVariance", 30.0)),
+	lastScore_(0.0),
+	evaluated_(0),
+	skipped_(0),
+	filterMs_(0.0),
+	detectionMs(0.0),
+	detections(0)
+{
+}
+
+bool BlurFilter::accept(const cv::Mat &gray)
+{
+	if(!enabled_){
+		return true;
+	}
+
+	auto start = clk::now();
+
+	const int side = std::max(gray.cols, gray.rows);
+	if(side > maxSide){
+		const double scale = static_cast<double>(maxSide) / side;
+		cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+	}
+	else{
+		small = gray;
+	}
+
+	cv::Laplacian(small, laplacian, CV_16S);
+
+	cv::Scalar mean, stddev;
+	cv::meanStdDev(laplacian, mean, stddev);
+	lastScore_ = stddev[0] * stddev[0];
+
+	evaluated_++;
+	filterMs_ += std::chrono::duration<double, std::milli>(clk::now() - start).count();
+
+	if(lastScore_ < minVariance){
+		skipped_++;
+		return false;
+	}
+	return true;
+}
+
+void BlurFilter::detectionTook(double ms)
+{
+	detectionMs += ms;
+	detections++;
+}
+
+double BlurFilter::savedMs() const
+{
+	if(detections == 0){
+		return 0.0;
+	}
+	return skipped_ * (detectionMs / detections) - filterMs_;
+}
+
+std::string BlurFilter::toJson() const
+{
+	std::ostringstream js;
+
+	js << "{\"enabled\" : " << (enabled_ ? "true" : "false")
+		<< ", \"min_laplacian_variance\" : " << minVariance
+		<< ", \"evaluated\" : " << evaluated_
+		<< ", \"skipped\" : " << skipped_
+		<< ", \"filter_ms\" : " << filterMs_
+		<< ", \"saved_ms\" : " << savedMs()
+		<< "}";
+
+	return js.str();
+}
+
+
+DuplicateFilter::DuplicateFilter(const YAML::Node &config):
+	enabled_(valueOr<bool>(config, "Enabled", false)),
+	window(valueOr<size_t>(config, "Window", 30)),
+	maxDistance(valueOr<int>(config, "MaxHammingDistance", 4)),
+	lastDistance_(64),
+	evaluated_(0),
+	dropped_(0)
+{
+}
+
+uint64_t DuplicateFilter::hash(const cv::Mat &gray, cv::Mat &thumb, cv::Mat &freq)
+{
+	constexpr int THUMB_SIDE = 32;
+	constexpr int HASH_SIDE = 8;
+
+	cv::resize(gray, thumb, cv::Size(THUMB_SIDE, THUMB_SIDE), 0, 0, cv::INTER_AREA);
+	thumb.convertTo(thumb, CV_32F);
+	cv::dct(thumb, freq);
+
+	// low frequencies without the dc term
+	std::array<float, HASH_SIDE * HASH_SIDE - 1> coeffs;
+	int k = 0;
+	for(int y = 0; y < HASH_SIDE; y++){
+		for(int x = 0; x < HASH_SIDE; x++){
+			if(x || y){
+				coeffs[k++] = freq.at<float>(y, x);
+			}
+		}
+	}
+
+	std::array<float, HASH_SIDE * HASH_SIDE - 1> sorted = coeffs;
+	std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+	const float median = sorted[sorted.size() / 2];
+
+	uint64_t h = 0;
+	for(size_t i = 0; i < coeffs.size(); i++){
+		if(coeffs[i] > median){
+			h |= uint64_t(1) << i;
+		}
+	}
+	return h;
+}
+
+int DuplicateFilter::distance(uint64_t a, uint64_t b)
+{
+	return static_cast<int>(std::bitset<64>(a ^ b).count());
+}
+
+bool DuplicateFilter::accept(const cv::Mat &gray)
+{
+	if(!enabled_){
+		return true;
+	}
+
+	const uint64_t h = hash(gray, thumb, freq);
+	evaluated_++;
+
+	lastDistance_ = 64;
+	for(uint64_t r : recent){
+		lastDistance_ = std::min(lastDistance_, distance(h, r));
+	}
+
+	if(lastDistance_ <= maxDistance){
+		dropped_++;
+		return false;
+	}
+
+	recent.push_back(h);
+	if(recent.size() > window){
+		recent.pop_front();
+	}
+	return true;
+}
+
+std::string DuplicateFilter::toJson() const
+{
+	std::ostringstream js;
+
+	js << "{\"enabled\" : " << (enabled_ ? "true" : "false")
+		<< ", \"window\" : " << window
+		<< ", \"max_hamming_distance\" : " << maxDistance
+		<< ", \"evaluated\" : " << evaluated_
+		<< ", \"dropped\" : " << dropped_
+		<< "}";
+
+	return js.str();
+}
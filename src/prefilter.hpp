@@ -0,0 +1,116 @@
+#ifndef PREFILTER_HPP_B1YK6ZSO
+#define PREFILTER_HPP_B1YK6ZSO
+
+#include <string>
+#include <deque>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+/*
+ * Cheap checks run before pattern detection so hopeless frames never
+ * reach findPoints. Each filter is configured from its own optional
+ * section of the calibration yml and is disabled when it is missing.
+ */
+
+/*
+ * Rejects motion blurred frames on the variance of the Laplacian of a
+ * downscaled copy.
+ *
+ *   BlurFilter:
+ *     Enabled: true
+ *     MaxSide: 640                # longest side of the downscaled copy
+ *     MinLaplacianVariance: 30.0  # below this the frame is skipped
+ */
+class BlurFilter {
+	public:
+		BlurFilter() = delete;
+
+		BlurFilter(const YAML::Node &config);
+
+		~BlurFilter() = default;
+
+		// true if the frame is sharp enough to run detection on
+		bool accept(const cv::Mat &gray);
+
+		// detection time of accepted frames, used to estimate the time saved
+		void detectionTook(double ms);
+
+		bool enabled() const {return enabled_;}
+		double lastScore() const {return lastScore_;}
+		int evaluated() const {return evaluated_;}
+		int skipped() const {return skipped_;}
+		double filterMs() const {return filterMs_;}
+		double savedMs() const;
+
+		// json object for summary.json
+		std::string toJson() const;
+
+	private:
+
+		bool enabled_;
+		int maxSide;
+		double minVariance;
+
+		cv::Mat small;
+		cv::Mat laplacian;
+
+		double lastScore_;
+		int evaluated_;
+		int skipped_;
+		double filterMs_;
+		double detectionMs;
+		int detections;
+};
+
+/*
+ * Drops near duplicate frames, e.g. while the drone hovers. A 64 bit
+ * perceptual hash (sign of the low DCT frequencies of a 32x32 thumbnail
+ * against their median) is compared with the hashes of the last Window
+ * frames it let through.
+ *
+ *   DuplicateFilter:
+ *     Enabled: true
+ *     Window: 30               # recently accepted frames to compare against
+ *     MaxHammingDistance: 4    # at or below this a frame counts as duplicate
+ */
+class DuplicateFilter {
+	public:
+		DuplicateFilter() = delete;
+
+		DuplicateFilter(const YAML::Node &config);
+
+		~DuplicateFilter() = default;
+
+		// true if the frame differs from the recently accepted ones
+		bool accept(const cv::Mat &gray);
+
+		bool enabled() const {return enabled_;}
+		int lastDistance() const {return lastDistance_;}
+		int evaluated() const {return evaluated_;}
+		int dropped() const {return dropped_;}
+
+		// json object for summary.json
+		std::string toJson() const;
+
+		static uint64_t hash(const cv::Mat &gray, cv::Mat &thumb, cv::Mat &freq);
+		static int distance(uint64_t a, uint64_t b);
+
+	private:
+
+		bool enabled_;
+		size_t window;
+		int maxDistance;
+
+		std::deque<uint64_t> recent;
+		cv::Mat thumb;
+		cv::Mat freq;
+
+		int lastDistance_;
+		int evaluated_;
+		int dropped_;
+};
+
+#endif /* end of include guard: PREFILTER_HPP_B1YK6ZSO */
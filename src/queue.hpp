@@ -0,0 +1,89 @@
+#ifndef QUEUE_HPP_HJ4CZ0UA
+#define QUEUE_HPP_HJ4CZ0UA
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Blocking fifo with a fixed capacity, for handing work between threads.
+ * close() wakes everyone, pop() keeps draining what is left and then
+ * returns false.
+ */
+template<typename T>
+class BoundedQueue {
+	public:
+		explicit BoundedQueue(size_t capacity):
+			capacity_(capacity > 0 ? capacity : 1),
+			closed_(false)
+		{}
+
+		BoundedQueue(const BoundedQueue &other) = delete;
+		BoundedQueue &operator=(const BoundedQueue &other) = delete;
+
+		// blocks while full, false if the queue was closed
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			notFull_.wait(lock, [this]{return closed_ || items_.size() < capacity_;});
+			if(closed_){
+				return false;
+			}
+			items_.push_back(std::move(item));
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		// never blocks, false if full or closed
+		bool tryPush(T item)
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if(closed_ || items_.size() >= capacity_){
+				return false;
+			}
+			items_.push_back(std::move(item));
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		// blocks while empty, false once closed and drained
+		bool pop(T &item)
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			notEmpty_.wait(lock, [this]{return closed_ || !items_.empty();});
+			if(items_.empty()){
+				return false;
+			}
+			item = std::move(items_.front());
+			items_.pop_front();
+			notFull_.notify_one();
+			return true;
+		}
+
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			closed_ = true;
+			notEmpty_.notify_all();
+			notFull_.notify_all();
+		}
+
+		size_t size() const
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			return items_.size();
+		}
+
+		size_t capacity() const {return capacity_;}
+
+	private:
+
+		const size_t capacity_;
+		bool closed_;
+		std::deque<T> items_;
+		mutable std::mutex mtx_;
+		std::condition_variable notEmpty_;
+		std::condition_variable notFull_;
+};
+
+#endif /* end of include guard: QUEUE_HPP_HJ4CZ0UA */
@@ -0,0 +1,95 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "utils.hpp"
+#include "refine.hpp"
+
+CornerRefiner::CornerRefiner(const YAML::Node &config, const CalibrationConfig &calibConf):
+	windowFraction(valueOr<double>(config, "WindowFraction", 0.35)),
+	minHalfWindow(valueOr<int>(config, "MinHalfWindow", 2)),
+	maxHalfWindow(valueOr<int>(config, "MaxHalfWindow", 15)),
+	minCornersPerThread(valueOr<int>(config, "MinCornersPerThread", 32)),
+	ps(calibConf.patternSize()),
+	// separate from the solver's TermCriteria, tuning one must not move the other
+	crit(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS,
+			valueOr<int>(config, "MaxIter", 30),
+			valueOr<double>(config, "Eps", 0.001))
+{
+	const std::string method = valueOr<std::string>(config, "Method", "AUTO");
+
+	if(method == "AUTO"){
+		enabled_ = calibConf.pointType() == PointType::C_CHESS;
+	}
+	else if(method == "CORNER"){
+		enabled_ = true;
+	}
+	else if(method == "NONE"){
+		enabled_ = false;
+	}
+	else{
+		throw std::runtime_error(method + " is not a valid sub-pixel method!\n");
+	}
+
+	if(minHalfWindow < 1 || maxHalfWindow < minHalfWindow || minCornersPerThread < 1){
+		throw std::runtime_error("Invalid SubPix window or chunk size!\n");
+	}
+}
+
+cv::Size CornerRefiner::halfWindow(const vecp2f &corners) const
+{
+	// median distance between neighbours along the pattern rows
+	thread_local std::vector<float> dists;
+	dists.clear();
+
+	if(corners.size() == static_cast<size_t>(ps.area())){
+		for(int r = 0; r < ps.height; r++){
+			for(int c = 0; c + 1 < ps.width; c++){
+				const cv::Point2f d = corners[r * ps.width + c + 1] - corners[r * ps.width + c];
+				dists.push_back(std::hypot(d.x, d.y));
+			}
+		}
+	}
+
+	if(dists.empty()){
+		return cv::Size(maxHalfWindow, maxHalfWindow);
+	}
+
+	std::nth_element(dists.begin(), dists.begin() + dists.size() / 2, dists.end());
+	const double square = dists[dists.size() / 2];
+
+	const int half = std::clamp(static_cast<int>(std::lround(windowFraction * square)),
+			minHalfWindow, maxHalfWindow);
+	return cv::Size(half, half);
+}
+
+bool CornerRefiner::refine(const cv::Mat &gray, vecp2f &corners) const
+{
+	if(!enabled_ || corners.empty()){
+		return false;
+	}
+
+	const cv::Size win = halfWindow(corners);
+	const int n = static_cast<int>(corners.size());
+	const int chunks = std::max(1, std::min(cv::getNumThreads(), n / minCornersPerThread));
+
+	// corners are refined independently, so each chunk works on its own
+	// slice of the vector in place
+	cv::parallel_for_(cv::Range(0, chunks), [&](const cv::Range &range){
+		for(int k = range.start; k < range.end; k++){
+			const int begin = k * n / chunks;
+			const int end = (k + 1) * n / chunks;
+			cv::Mat slice(end - begin, 1, CV_32FC2, &corners[begin]);
+			cv::cornerSubPix(gray, slice, win, cv::Size(-1, -1), crit);
+		}
+	});
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#ifndef REFINE_HPP_X4WD8NQA
+#define REFINE_HPP_X4WD8NQA
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+
+/*
+ * Sub-pixel refinement of detected corners. The corners are split over
+ * threads, each chunk refined by cornerSubPix in place, and the search
+ * window follows the square size measured in the image instead of a fixed
+ * 11x11. SB_CHESS corners are already sub-pixel and circle centres are
+ * not corners, so both are left alone unless forced.
+ *
+ * Configured from the optional "SubPix" section of the calibration yml:
+ *
+ *   SubPix:
+ *     Method: AUTO              # AUTO, CORNER or NONE
+ *     WindowFraction: 0.35      # half window as fraction of the square size
+ *     MinHalfWindow: 2
+ *     MaxHalfWindow: 15
+ *     MinCornersPerThread: 32   # smaller chunks are not worth a thread
+ *     MaxIter: 30               # cornerSubPix stop criteria, independent
+ *     Eps: 0.001                # of the solver's TermCriteria
+ */
+class CornerRefiner {
+	public:
+		CornerRefiner() = delete;
+
+		CornerRefiner(const YAML::Node &config, const CalibrationConfig &calibConf);
+
+		~CornerRefiner() = default;
+
+		// refines corners in place, returns false if the method is NONE
+		bool refine(const cv::Mat &gray, vecp2f &corners) const;
+
+		// half window picked for these corners
+		cv::Size halfWindow(const vecp2f &corners) const;
+
+		bool enabled() const {return enabled_;}
+
+	private:
+
+		bool enabled_;
+		double windowFraction;
+		int minHalfWindow;
+		int maxHalfWindow;
+		int minCornersPerThread;
+
+		cv::Size ps;
+		cv::TermCriteria crit;
+};
+
+#endif /* end of include guard: REFINE_HPP_X4WD8NQA */
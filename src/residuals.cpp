@@ -0,0 +1,46 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+
+#include <opencv2/core.hpp>
+
+#include "residuals.hpp"
+
+std::string Residuals::toJson() const
+{
+	std::ostringstream js;
+
+	js << "{\"rms\" : " << rms
+		<< ", \"max_error\" : " << maxError
+		<< ", \"grid\" : [" << heatGrid.width << ", " << heatGrid.height << "]"
+		<< ", \"heatmap\" : [";
+
+	for(int y = 0; y < heatGrid.height; y++){
+		js << (y ? ", " : "") << '[';
+		for(int x = 0; x < heatGrid.width; x++){
+			js << (x ? ", " : "") << heat(x, y);
+		}
+		js << ']';
+	}
+	js << "]}";
+
+	return js.str();
+}
+
+bool Residuals::writeCsv(const std::string &path) const
+{
+	std::ofstream csv(path);
+	if(!csv.is_open() || !csv.good()){
+		return false;
+	}
+
+	csv << "view,corner,dx,dy,error\n";
+	for(size_t v = 0; v < views(); v++){
+		for(size_t c = offsets[v]; c < offsets[v + 1]; c++){
+			csv << v << ',' << c - offsets[v] << ','
+				<< errors[c].x << ',' << errors[c].y << ',' << norms[c] << "\n";
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#ifndef RESIDUALS_HPP_T2LQ9XUD
+#define RESIDUALS_HPP_T2LQ9XUD
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/*
+ * Per-corner reprojection residuals for a set of views, stored flat:
+ * corners of view i are [offsets[i], offsets[i + 1]). Reusing the same
+ * object between evaluations keeps the buffers allocated.
+ *
+ * The heatmap is the mean residual norm of the corners observed in each
+ * cell of a grid over the image.
+ */
+struct Residuals {
+	std::vector<size_t> offsets;
+	std::vector<cv::Point2f> errors;  // projected - observed
+	std::vector<float> norms;
+	std::vector<double> viewRms;
+
+	cv::Size heatGrid{16, 12};
+	std::vector<double> heatSum;
+	std::vector<int> heatCount;
+
+	double rms = 0.0;
+	double maxError = 0.0;
+
+	size_t views() const {return viewRms.size();}
+	size_t corners() const {return errors.size();}
+
+	double heat(int cx, int cy) const
+	{
+		const int idx = cy * heatGrid.width + cx;
+		return heatCount[idx] > 0 ? heatSum[idx] / heatCount[idx] : 0.0;
+	}
+
+	// json object for summary.json
+	std::string toJson() const;
+
+	// one line per corner: view,corner,dx,dy,error
+	bool writeCsv(const std::string &path) const;
+};
+
+#endif /* end of include guard: RESIDUALS_HPP_T2LQ9XUD */
@@ -0,0 +1,77 @@
+#include <array>
+#include <string>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "utils.hpp"
+#include "sensormode.hpp"
+
+SensorModes::SensorModes(const YAML::Node &config):
+	sensorWidth_(0.0),
+	sensorHeight_(0.0)
+{
+	if(!config.IsDefined() || config.IsNull()){
+		return;
+	}
+
+	sensorWidth_ = valueOr<double>(config["Sensor"], "Width", 0.0);
+	sensorHeight_ = valueOr<double>(config["Sensor"], "Height", 0.0);
+
+	if(!config["Modes"]){
+		return;
+	}
+
+	for(const auto &m : config["Modes"]){
+		SensorMode mode;
+		mode.name = m["Name"].as<std::string>();
+
+		std::array<double, 2> offset = valueOr<std::array<double, 2>>(m, "Offset", {0.0, 0.0});
+		std::array<double, 2> crop = m["Crop"].as<std::array<double, 2>>();
+		std::array<int, 2> size = m["Size"].as<std::array<int, 2>>();
+
+		mode.crop = cv::Rect2d(offset[0], offset[1], crop[0], crop[1]);
+		mode.size = cv::Size(size[0], size[1]);
+
+		if(crop[0] <= 0.0 || crop[1] <= 0.0 || size[0] <= 0 || size[1] <= 0){
+			throw std::runtime_error("Sensor mode " + mode.name + " needs a positive crop and size!\n");
+		}
+
+		modes_.push_back(mode);
+	}
+}
+
+const SensorMode &SensorModes::mode(const std::string &name) const
+{
+	for(const auto &m : modes_){
+		if(m.name == name){
+			return m;
+		}
+	}
+	throw std::runtime_error(name + " is not a declared sensor mode!\n");
+}
+
+Camera SensorModes::derive(const Camera &reference, const SensorMode &mode) const
+{
+	const cv::Rect2d image(0.0, 0.0, reference.pixWidth(), reference.pixHeight());
+
+	if((mode.crop & image) != mode.crop){
+		throw std::runtime_error("Sensor mode " + mode.name
+				+ " reads outside the calibrated image!\n");
+	}
+
+	return reference.derive(reference.name() + "_" + mode.name, mode.crop, mode.size);
+}
+
+const Camera &SensorModes::undistorter(const Camera &reference, const std::string &name)
+{
+	auto it = cache.find(name);
+	if(it == cache.end()){
+		const SensorMode &m = mode(name);
+		it = cache.emplace(name, derive(reference, m)).first;
+		it->second.initUndistortMaps(m.size);
+	}
+	return it->second;
+}
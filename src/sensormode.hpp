@@ -0,0 +1,68 @@
+#ifndef SENSORMODE_HPP_Q7ZC3MHE
+#define SENSORMODE_HPP_Q7ZC3MHE
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+
+struct SensorMode {
+	std::string name;
+	cv::Rect2d crop; // read out region, in pixels of the calibrated image
+	cv::Size size;   // resolution delivered by the mode
+};
+
+/*
+ * Sensor description and the capture modes that share its optics, so one
+ * calibration serves every mode. Offsets and crops are given in pixels of
+ * the images the camera was calibrated with.
+ *
+ *   Sensor:
+ *     Width: 13.2           # mm
+ *     Height: 8.8
+ *   Modes:
+ *     - Name: 4K
+ *       Offset: [0, 285]
+ *       Crop: [5472, 3078]
+ *       Size: [3840, 2160]
+ *
+ * One instance serves one reference camera, the undistortion maps of
+ * every mode are built on first use and cached.
+ */
+class SensorModes {
+	public:
+		SensorModes() = delete;
+
+		SensorModes(const YAML::Node &config);
+
+		SensorModes(const SensorModes &other) = delete;
+		SensorModes &operator=(const SensorModes &other) = delete;
+
+		~SensorModes() = default;
+
+		// mm, 0 when the file gives no sensor size
+		double sensorWidth() const {return sensorWidth_;}
+		double sensorHeight() const {return sensorHeight_;}
+
+		const std::vector<SensorMode> &modes() const {return modes_;}
+		const SensorMode &mode(const std::string &name) const;
+
+		Camera derive(const Camera &reference, const SensorMode &mode) const;
+
+		// derived camera with its undistortion maps built
+		const Camera &undistorter(const Camera &reference, const std::string &name);
+
+	private:
+
+		double sensorWidth_;
+		double sensorHeight_;
+		std::vector<SensorMode> modes_;
+		std::map<std::string, Camera> cache;
+};
+
+#endif /* end of include guard: SENSORMODE_HPP_Q7ZC3MHE */
@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+#include "utils.hpp"
+#include "session.hpp"
+
+CalibrationSession::CalibrationSession(const YAML::Node &config, const std::string &name):
+	calibConf(config),
+	refiner(config["SubPix"], calibConf),
+	cam(name),
+	attempts_(0),
+	rms_(0.0)
+{
+	// the board never changes, build it once
+	createKnownBoardDim(calibConf.patternSize(), calibConf.dim(), board);
+}
+
+bool CalibrationSession::addImage(const cv::Mat &image)
+{
+	if(image.empty() || image.type() != CV_8UC1){
+		throw std::runtime_error("Session expects 8 bit grayscale images!\n");
+	}
+
+	if(imageSize.empty()){
+		imageSize = image.size();
+		cam.setPixWidth(imageSize.width);
+		cam.setPixHeight(imageSize.height);
+	}
+	else if(image.size() != imageSize){
+		throw std::runtime_error("Image size differs from the first image in session!\n");
+	}
+
+	attempts_++;
+	foundPoints.clear();
+
+	if(!calibConf.findPoints(image, foundPoints)){
+		return false;
+	}
+
+	refiner.refine(image, foundPoints);
+
+	imagePoints.push_back(foundPoints);
+	worldPoints.push_back(board);
+
+	return true;
+}
+
+double CalibrationSession::solve()
+{
+	if(imagePoints.empty()){
+		throw std::runtime_error("No views in session to solve!\n");
+	}
+
+	// warm start from the previous solution once there is one
+	const int extraFlags = cam.isCalibrated() ? cv::CALIB_USE_INTRINSIC_GUESS : 0;
+
+	// uncertainties are only computed when the session is written
+	rms_ = cam.calibrate(worldPoints, imagePoints, calibConf, extraFlags, true);
+	return rms_;
+}
+
+bool CalibrationSession::write(const std::string &output)
+{
+	if(!cam.isCalibrated()){
+		return false;
+	}
+	return cam.write(output) && cam.dumpStats(output);
+}
@@ -0,0 +1,63 @@
+#ifndef SESSION_HPP_W8DM2PLQ
+#define SESSION_HPP_W8DM2PLQ
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include "camera.hpp"
+#include "refine.hpp"
+
+/*
+ * Calibration state that outlives a single run: the parsed config,
+ * the detector, every accepted detection and the current camera model.
+ * Adding a frame only costs its own detection, and re-solving warm starts
+ * from the previous solution.
+ */
+class CalibrationSession {
+	public:
+		CalibrationSession() = delete;
+
+		CalibrationSession(const YAML::Node &config, const std::string &name);
+
+		CalibrationSession(const CalibrationSession &other) = delete;
+		CalibrationSession &operator=(const CalibrationSession &other) = delete;
+
+		~CalibrationSession() = default;
+
+		// expects an 8 bit grayscale image, returns true if the pattern was found
+		bool addImage(const cv::Mat &image);
+
+		double solve();
+
+		bool write(const std::string &output);
+
+		size_t views() const {return imagePoints.size();}
+		size_t attempts() const {return attempts_;}
+		double rms() const {return rms_;}
+		bool solved() const {return cam.isCalibrated();}
+
+		Camera &camera() {return cam;}
+		const Camera &camera() const {return cam;}
+		const CalibrationConfig &config() const {return calibConf;}
+
+	private:
+
+		CalibrationConfig calibConf;
+		CornerRefiner refiner;
+		Camera cam;
+
+		vecp3f board;
+		std::vector<vecp3f> worldPoints;
+		std::vector<vecp2f> imagePoints;
+		vecp2f foundPoints;
+
+		cv::Size imageSize;
+		size_t attempts_;
+		double rms_;
+};
+
+#endif /* end of include guard: SESSION_HPP_W8DM2PLQ */
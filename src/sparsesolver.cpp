@@ -0,0 +1,532 @@
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "sparsesolver.hpp"
+
+constexpr int NUMBR_EXTRINSIC = 6;
+constexpr int NUMBR_INTRINSIC_STDDEV = 18;
+
+namespace {
+
+// one calibration view, converted once to double precision
+struct View {
+	cv::Mat obj;  // n x 1, CV_64FC3
+	cv::Mat img;  // n x 1, CV_64FC2
+	cv::Mat r;
+	cv::Mat t;
+};
+
+// what a single view contributes to the normal equations
+struct ViewBlock {
+	cv::Mat U;  // nIntr x nIntr
+	cv::Mat W;  // nIntr x 6, intrinsic/extrinsic coupling
+	cv::Mat V;  // 6 x 6
+	cv::Mat ga; // nIntr x 1
+	cv::Mat ge; // 6 x 1
+	double err;
+};
+
+// intrinsic parameter vector is [fx, fy, cx, cy, dist...], same ordering
+// as the jacobian columns returned by cv::projectPoints
+struct Model {
+	int nDist;
+	std::vector<bool> fixed;
+	bool fixAspect;
+	double aspect; // fx / fy
+};
+
+int distortionCount(int flags)
+{
+	if(flags & cv::CALIB_TILTED_MODEL)
+		return 14;
+	if(flags & cv::CALIB_THIN_PRISM_MODEL)
+		return 12;
+	if(flags & cv::CALIB_RATIONAL_MODEL)
+		return 8;
+	return 5;
+}
+
+Model buildModel(int flags, int nDist, double aspect)
+{
+	Model m;
+	m.nDist = nDist;
+	m.fixed.assign(4 + nDist, false);
+	m.fixAspect = flags & cv::CALIB_FIX_ASPECT_RATIO;
+	m.aspect = aspect;
+
+	auto fix = [&m](int idx){
+		if(idx < static_cast<int>(m.fixed.size()))
+			m.fixed[idx] = true;
+	};
+
+	if(flags & cv::CALIB_FIX_FOCAL_LENGTH){ fix(0); fix(1); }
+	// fx is tied to fy and follows it
+	if(m.fixAspect) fix(0);
+	if(flags & cv::CALIB_FIX_PRINCIPAL_POINT){ fix(2); fix(3); }
+	if(flags & (cv::CALIB_ZERO_TANGENT_DIST | cv::CALIB_FIX_TANGENT_DIST)){ fix(6); fix(7); }
+	if(flags & cv::CALIB_FIX_K1) fix(4);
+	if(flags & cv::CALIB_FIX_K2) fix(5);
+	if(flags & cv::CALIB_FIX_K3) fix(8);
+	if(flags & cv::CALIB_FIX_K4) fix(9);
+	if(flags & cv::CALIB_FIX_K5) fix(10);
+	if(flags & cv::CALIB_FIX_K6) fix(11);
+	if(flags & cv::CALIB_FIX_S1_S2_S3_S4){ fix(12); fix(13); fix(14); fix(15); }
+	if(flags & cv::CALIB_FIX_TAUX_TAUY){ fix(16); fix(17); }
+
+	return m;
+}
+
+void unpack(const cv::Mat &a, const Model &m, cv::Mat &K, cv::Mat &dist)
+{
+	K = cv::Mat::eye(3, 3, CV_64F);
+	K.at<double>(0,0) = a.at<double>(0,0);
+	K.at<double>(1,1) = a.at<double>(1,0);
+	K.at<double>(0,2) = a.at<double>(2,0);
+	K.at<double>(1,2) = a.at<double>(3,0);
+	dist = a.rowRange(4, 4 + m.nDist);
+}
+
+double viewResidual(const View &v, const cv::Mat &r, const cv::Mat &t,
+		const cv::Mat &K, const cv::Mat &dist, cv::Mat &res, cv::Mat *J)
+{
+	cv::Mat proj;
+
+	if(J)
+		cv::projectPoints(v.obj, r, t, K, dist, proj, *J);
+	else
+		cv::projectPoints(v.obj, r, t, K, dist, proj);
+
+	res = proj.reshape(1, 2 * v.obj.rows) - v.img.reshape(1, 2 * v.img.rows);
+	return res.dot(res);
+}
+
+// builds every view block in parallel, returns the total squared error
+double linearize(std::vector<View> &views, const cv::Mat &a, const Model &m,
+		std::vector<ViewBlock> &blocks, cv::Mat &U, cv::Mat &ga)
+{
+	cv::Mat K, dist;
+	unpack(a, m, K, dist);
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(views.size())),
+			[&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			ViewBlock &b = blocks[i];
+			cv::Mat res, J;
+
+			b.err = viewResidual(views[i], views[i].r, views[i].t, K, dist, res, &J);
+
+			cv::Mat Je = J.colRange(0, NUMBR_EXTRINSIC);
+			cv::Mat Ja = J.colRange(NUMBR_EXTRINSIC, NUMBR_EXTRINSIC + 4 + m.nDist).clone();
+
+			if(m.fixAspect){
+				cv::Mat dfy = Ja.col(1);
+				dfy += m.aspect * Ja.col(0);
+			}
+			for(size_t k = 0; k < m.fixed.size(); k++){
+				if(m.fixed[k])
+					Ja.col(k).setTo(0);
+			}
+
+			b.U = Ja.t() * Ja;
+			b.W = Ja.t() * Je;
+			b.V = Je.t() * Je;
+			b.ga = Ja.t() * res;
+			b.ge = Je.t() * res;
+		}
+	});
+
+	// summed serially to stay deterministic regardless of thread count
+	const int nIntr = 4 + m.nDist;
+	U = cv::Mat::zeros(nIntr, nIntr, CV_64F);
+	ga = cv::Mat::zeros(nIntr, 1, CV_64F);
+	double err = 0.0;
+
+	for(const auto &b : blocks){
+		U += b.U;
+		ga += b.ga;
+		err += b.err;
+	}
+
+	return err;
+}
+
+cv::Mat invertBlock(const cv::Mat &V)
+{
+	cv::Mat Vinv;
+	if(cv::invert(V, Vinv, cv::DECOMP_CHOLESKY) == 0)
+		cv::invert(V, Vinv, cv::DECOMP_SVD);
+	return Vinv;
+}
+
+// reduced camera system S = U - sum(W V^-1 W^T), extrinsics eliminated
+cv::Mat schurComplement(const std::vector<ViewBlock> &blocks, const cv::Mat &U,
+		const Model &m, double lambda,
+		std::vector<cv::Mat> &Vinv, cv::Mat &rhs, const cv::Mat &ga)
+{
+	const int nViews = static_cast<int>(blocks.size());
+	std::vector<cv::Mat> WVinvWt(nViews), WVinvge(nViews);
+
+	cv::parallel_for_(cv::Range(0, nViews), [&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			cv::Mat V = blocks[i].V.clone();
+			for(int j = 0; j < NUMBR_EXTRINSIC; j++)
+				V.at<double>(j,j) += lambda * std::max(V.at<double>(j,j), DBL_EPSILON);
+
+			Vinv[i] = invertBlock(V);
+			cv::Mat Y = blocks[i].W * Vinv[i];
+			WVinvWt[i] = Y * blocks[i].W.t();
+			WVinvge[i] = Y * blocks[i].ge;
+		}
+	});
+
+	cv::Mat S = U.clone();
+	for(int k = 0; k < S.rows; k++){
+		if(m.fixed[k])
+			S.at<double>(k,k) = 1.0;
+		else
+			S.at<double>(k,k) += lambda * std::max(S.at<double>(k,k), DBL_EPSILON);
+	}
+
+	rhs = -ga;
+	for(int i = 0; i < nViews; i++){
+		S -= WVinvWt[i];
+		rhs += WVinvge[i];
+	}
+
+	return S;
+}
+
+void solveStep(const std::vector<ViewBlock> &blocks, const cv::Mat &U,
+		const cv::Mat &ga, const Model &m, double lambda,
+		cv::Mat &da, std::vector<cv::Mat> &de)
+{
+	const int nViews = static_cast<int>(blocks.size());
+	std::vector<cv::Mat> Vinv(nViews);
+	cv::Mat rhs;
+
+	cv::Mat S = schurComplement(blocks, U, m, lambda, Vinv, rhs, ga);
+
+	if(!cv::solve(S, rhs, da, cv::DECOMP_CHOLESKY))
+		cv::solve(S, rhs, da, cv::DECOMP_SVD);
+
+	// back substitution, one independent 6x6 problem per view
+	cv::parallel_for_(cv::Range(0, nViews), [&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			de[i] = Vinv[i] * (-blocks[i].ge - blocks[i].W.t() * da);
+		}
+	});
+}
+
+double evaluate(const std::vector<View> &views, const cv::Mat &a, const Model &m,
+		const std::vector<cv::Mat> &r, const std::vector<cv::Mat> &t)
+{
+	cv::Mat K, dist;
+	unpack(a, m, K, dist);
+
+	std::vector<double> err(views.size());
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(views.size())),
+			[&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			cv::Mat res;
+			err[i] = viewResidual(views[i], r[i], t[i], K, dist, res, nullptr);
+		}
+	});
+
+	double total = 0.0;
+	for(double e : err)
+		total += e;
+	return total;
+}
+
+// standard deviations from the undamped reduced system at the solution
+void uncertainties(const std::vector<ViewBlock> &blocks, const cv::Mat &U,
+		const cv::Mat &ga, const Model &m, double cost, int totalPoints,
+		cv::Mat &stdDeviationsIntrinsics, cv::Mat &stdDeviationsExtrinsics)
+{
+	const int nViews = static_cast<int>(blocks.size());
+	const int nIntr = 4 + m.nDist;
+
+	std::vector<cv::Mat> Vinv(nViews);
+	cv::Mat rhs;
+	cv::Mat S = schurComplement(blocks, U, m, 0.0, Vinv, rhs, ga);
+	cv::Mat Sinv;
+	cv::invert(S, Sinv, cv::DECOMP_SVD);
+
+	int nFree = NUMBR_EXTRINSIC * nViews;
+	for(bool f : m.fixed)
+		nFree += f ? 0 : 1;
+
+	const double sigma2 = cost / std::max(1, 2 * totalPoints - nFree);
+
+	stdDeviationsIntrinsics = cv::Mat::zeros(NUMBR_INTRINSIC_STDDEV, 1, CV_64F);
+	for(int k = 0; k < nIntr; k++){
+		if(!m.fixed[k])
+			stdDeviationsIntrinsics.at<double>(k,0) = std::sqrt(Sinv.at<double>(k,k) * sigma2);
+	}
+	if(m.fixAspect)
+		stdDeviationsIntrinsics.at<double>(0,0) = m.aspect * stdDeviationsIntrinsics.at<double>(1,0);
+
+	stdDeviationsExtrinsics = cv::Mat::zeros(NUMBR_EXTRINSIC * nViews, 1, CV_64F);
+
+	cv::parallel_for_(cv::Range(0, nViews), [&](const cv::Range &range){
+		for(int i = range.start; i < range.end; i++){
+			cv::Mat VinvWt = Vinv[i] * blocks[i].W.t();
+			cv::Mat C = Vinv[i] + VinvWt * Sinv * VinvWt.t();
+
+			for(int j = 0; j < NUMBR_EXTRINSIC; j++){
+				stdDeviationsExtrinsics.at<double>(i * NUMBR_EXTRINSIC + j, 0) =
+					std::sqrt(std::max(C.at<double>(j,j), 0.0) * sigma2);
+			}
+		}
+	});
+}
+
+void viewErrors(const std::vector<View> &views, const std::vector<ViewBlock> &blocks,
+		cv::Mat &perViewErrors)
+{
+	perViewErrors = cv::Mat::zeros(static_cast<int>(views.size()), 1, CV_64F);
+	for(size_t i = 0; i < views.size(); i++){
+		perViewErrors.at<double>(i,0) =
+			std::sqrt(blocks[i].err / static_cast<double>(views[i].obj.rows));
+	}
+}
+
+} // namespace
+
+
+double calibrateCameraSparse(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		cv::Size imageSize,
+		cv::Mat &cameraMatrix,
+		cv::Mat &distCoeffs,
+		std::vector<cv::Mat> &rvecs,
+		std::vector<cv::Mat> &tvecs,
+		cv::Mat &stdDeviationsIntrinsics,
+		cv::Mat &stdDeviationsExtrinsics,
+		cv::Mat &perViewErrors,
+		int flags,
+		cv::TermCriteria criteria,
+		bool computeUncertainties,
+		int *iterations)
+{
+	const int nViews = static_cast<int>(objectPoints.size());
+
+	if(nViews == 0 || imagePoints.size() != objectPoints.size()){
+		throw std::runtime_error("Sparse calibration needs one set of image points per view!\n");
+	}
+
+	const int nDist = distortionCount(flags);
+	const int nIntr = 4 + nDist;
+
+	double aspect = 1.0;
+	if(!cameraMatrix.empty() && cameraMatrix.at<double>(1,1) != 0.0)
+		aspect = cameraMatrix.at<double>(0,0) / cameraMatrix.at<double>(1,1);
+
+	// initial intrinsics
+	cv::Mat a = cv::Mat::zeros(nIntr, 1, CV_64F);
+
+	if(flags & cv::CALIB_USE_INTRINSIC_GUESS){
+		cv::Mat d;
+		distCoeffs.convertTo(d, CV_64F);
+		d = d.reshape(1, static_cast<int>(d.total()));
+
+		a.at<double>(0,0) = cameraMatrix.at<double>(0,0);
+		a.at<double>(1,0) = cameraMatrix.at<double>(1,1);
+		a.at<double>(2,0) = cameraMatrix.at<double>(0,2);
+		a.at<double>(3,0) = cameraMatrix.at<double>(1,2);
+
+		for(int j = 0; j < std::min(nDist, static_cast<int>(d.total())); j++)
+			a.at<double>(4 + j, 0) = d.at<double>(j, 0);
+	}
+	else{
+		cv::Mat K = cv::initCameraMatrix2D(objectPoints, imagePoints, imageSize,
+				(flags & cv::CALIB_FIX_ASPECT_RATIO) ? aspect : 0.0);
+
+		a.at<double>(0,0) = K.at<double>(0,0);
+		a.at<double>(1,0) = K.at<double>(1,1);
+		a.at<double>(2,0) = K.at<double>(0,2);
+		a.at<double>(3,0) = K.at<double>(1,2);
+	}
+
+	if(flags & cv::CALIB_ZERO_TANGENT_DIST){
+		a.at<double>(6,0) = 0.0;
+		a.at<double>(7,0) = 0.0;
+	}
+
+	const Model m = buildModel(flags, nDist, aspect);
+	if(m.fixAspect)
+		a.at<double>(0,0) = m.aspect * a.at<double>(1,0);
+
+	// initial poses, the given ones or one independent PnP per view
+	std::vector<View> views(nViews);
+	int totalPoints = 0;
+	{
+		cv::Mat K, dist;
+		unpack(a, m, K, dist);
+
+		const bool posesGiven = (flags & cv::CALIB_USE_EXTRINSIC_GUESS)
+			&& rvecs.size() == static_cast<size_t>(nViews)
+			&& tvecs.size() == static_cast<size_t>(nViews);
+
+		for(int i = 0; i < nViews; i++)
+			totalPoints += static_cast<int>(objectPoints[i].size());
+
+		cv::parallel_for_(cv::Range(0, nViews), [&](const cv::Range &range){
+			for(int i = range.start; i < range.end; i++){
+				cv::Mat(objectPoints[i]).convertTo(views[i].obj, CV_64F);
+				cv::Mat(imagePoints[i]).convertTo(views[i].img, CV_64F);
+				if(posesGiven){
+					rvecs[i].reshape(1, 3).convertTo(views[i].r, CV_64F);
+					tvecs[i].reshape(1, 3).convertTo(views[i].t, CV_64F);
+				}
+				else{
+					cv::solvePnP(views[i].obj, views[i].img, K, dist, views[i].r, views[i].t);
+				}
+			}
+		});
+	}
+
+	const int maxIter = (criteria.type & cv::TermCriteria::COUNT) ? criteria.maxCount : 30;
+	const double eps = (criteria.type & cv::TermCriteria::EPS) ? criteria.epsilon : DBL_EPSILON;
+
+	std::vector<ViewBlock> blocks(nViews);
+	std::vector<cv::Mat> de(nViews), rNew(nViews), tNew(nViews);
+	cv::Mat U, ga, da;
+
+	double lambda = 1e-3;
+	double cost = linearize(views, a, m, blocks, U, ga);
+	int iter = 0;
+
+	while(iter < maxIter){
+		iter++;
+
+		solveStep(blocks, U, ga, m, lambda, da, de);
+
+		cv::Mat aNew = a + da;
+		if(m.fixAspect)
+			aNew.at<double>(0,0) = m.aspect * aNew.at<double>(1,0);
+
+		double stepNorm = da.dot(da);
+		double paramNorm = a.dot(a);
+
+		for(int i = 0; i < nViews; i++){
+			rNew[i] = views[i].r + de[i].rowRange(0, 3);
+			tNew[i] = views[i].t + de[i].rowRange(3, 6);
+			stepNorm += de[i].dot(de[i]);
+			paramNorm += views[i].r.dot(views[i].r) + views[i].t.dot(views[i].t);
+		}
+
+		const bool converged = std::sqrt(stepNorm) <= eps * std::sqrt(paramNorm);
+		const double newCost = evaluate(views, aNew, m, rNew, tNew);
+
+		if(newCost < cost){
+			a = aNew;
+			for(int i = 0; i < nViews; i++){
+				views[i].r = rNew[i];
+				views[i].t = tNew[i];
+			}
+			lambda = std::max(lambda * 0.1, 1e-12);
+			cost = linearize(views, a, m, blocks, U, ga);
+		}
+		else{
+			lambda *= 10.0;
+		}
+
+		if(converged || lambda > 1e12)
+			break;
+	}
+
+	if(iterations)
+		*iterations = iter;
+
+	if(computeUncertainties){
+		uncertainties(blocks, U, ga, m, cost, totalPoints,
+				stdDeviationsIntrinsics, stdDeviationsExtrinsics);
+	}
+	else{
+		stdDeviationsIntrinsics.release();
+		stdDeviationsExtrinsics.release();
+	}
+	viewErrors(views, blocks, perViewErrors);
+
+	// outputs
+	cv::Mat K, dist;
+	unpack(a, m, K, dist);
+	cameraMatrix = K;
+
+	cv::Mat distOut = cv::Mat::zeros(std::max(nDist, static_cast<int>(distCoeffs.total())), 1, CV_64F);
+	cv::Mat distHead = distOut.rowRange(0, nDist);
+	dist.copyTo(distHead);
+	distCoeffs = distOut;
+
+	rvecs.resize(nViews);
+	tvecs.resize(nViews);
+	for(int i = 0; i < nViews; i++){
+		rvecs[i] = views[i].r.clone();
+		tvecs[i] = views[i].t.clone();
+	}
+
+	return std::sqrt(cost / totalPoints);
+}
+
+double sparseUncertainties(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		const cv::Mat &cameraMatrix,
+		const cv::Mat &distCoeffs,
+		const std::vector<cv::Mat> &rvecs,
+		const std::vector<cv::Mat> &tvecs,
+		int flags,
+		cv::Mat &stdDeviationsIntrinsics,
+		cv::Mat &stdDeviationsExtrinsics,
+		cv::Mat &perViewErrors)
+{
+	const int nViews = static_cast<int>(objectPoints.size());
+
+	if(nViews == 0 || imagePoints.size() != objectPoints.size()
+			|| rvecs.size() != objectPoints.size() || tvecs.size() != objectPoints.size()){
+		throw std::runtime_error("Uncertainties need points and a pose per view!\n");
+	}
+
+	const int nDist = distortionCount(flags);
+	const double aspect = cameraMatrix.at<double>(0,0) / cameraMatrix.at<double>(1,1);
+	const Model m = buildModel(flags, nDist, aspect);
+
+	cv::Mat a = cv::Mat::zeros(4 + nDist, 1, CV_64F);
+	a.at<double>(0,0) = cameraMatrix.at<double>(0,0);
+	a.at<double>(1,0) = cameraMatrix.at<double>(1,1);
+	a.at<double>(2,0) = cameraMatrix.at<double>(0,2);
+	a.at<double>(3,0) = cameraMatrix.at<double>(1,2);
+
+	cv::Mat d;
+	distCoeffs.convertTo(d, CV_64F);
+	d = d.reshape(1, static_cast<int>(d.total()));
+	for(int j = 0; j < std::min(nDist, static_cast<int>(d.total())); j++)
+		a.at<double>(4 + j, 0) = d.at<double>(j, 0);
+
+	std::vector<View> views(nViews);
+	int totalPoints = 0;
+	for(int i = 0; i < nViews; i++){
+		cv::Mat(objectPoints[i]).convertTo(views[i].obj, CV_64F);
+		cv::Mat(imagePoints[i]).convertTo(views[i].img, CV_64F);
+		rvecs[i].reshape(1, 3).convertTo(views[i].r, CV_64F);
+		tvecs[i].reshape(1, 3).convertTo(views[i].t, CV_64F);
+		totalPoints += static_cast<int>(objectPoints[i].size());
+	}
+
+	std::vector<ViewBlock> blocks(nViews);
+	cv::Mat U, ga;
+	const double cost = linearize(views, a, m, blocks, U, ga);
+
+	uncertainties(blocks, U, ga, m, cost, totalPoints,
+			stdDeviationsIntrinsics, stdDeviationsExtrinsics);
+	viewErrors(views, blocks, perViewErrors);
+
+	return std::sqrt(cost / totalPoints);
+}
@@ -0,0 +1,56 @@
+#ifndef SPARSESOLVER_HPP_K3QX7TRM
+#define SPARSESOLVER_HPP_K3QX7TRM
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "camera.hpp"
+
+/*
+ * Levenberg-Marquardt calibration that exploits the block structure of the
+ * problem: every view only couples its own 6 extrinsics with the shared
+ * intrinsics. The extrinsics are eliminated with a Schur complement so each
+ * iteration costs one small (intrinsics sized) dense solve plus work that is
+ * linear in the number of views. Per-view Jacobians are evaluated in parallel.
+ *
+ * Mirrors cv::calibrateCamera: same flags (the CALIB_FIX_* / model flags),
+ * same outputs, 18x1 intrinsic and 6Nx1 extrinsic standard deviations.
+ * With CALIB_USE_EXTRINSIC_GUESS the given rvecs/tvecs are the starting
+ * poses instead of a PnP solve per view.
+ * Returns the overall RMS reprojection error.
+ */
+double calibrateCameraSparse(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		cv::Size imageSize,
+		cv::Mat &cameraMatrix,
+		cv::Mat &distCoeffs,
+		std::vector<cv::Mat> &rvecs,
+		std::vector<cv::Mat> &tvecs,
+		cv::Mat &stdDeviationsIntrinsics,
+		cv::Mat &stdDeviationsExtrinsics,
+		cv::Mat &perViewErrors,
+		int flags,
+		cv::TermCriteria criteria,
+		bool computeUncertainties = true,
+		int *iterations = nullptr);
+
+/*
+ * Standard deviations and per-view errors of an already converged solution,
+ * laid out as calibrateCameraSparse returns them, for solves that skipped
+ * them. Linearizes once at the given parameters; flags select the model and
+ * the fixed parameters as in the solve. Returns the RMS reprojection error.
+ */
+double sparseUncertainties(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		const cv::Mat &cameraMatrix,
+		const cv::Mat &distCoeffs,
+		const std::vector<cv::Mat> &rvecs,
+		const std::vector<cv::Mat> &tvecs,
+		int flags,
+		cv::Mat &stdDeviationsIntrinsics,
+		cv::Mat &stdDeviationsExtrinsics,
+		cv::Mat &perViewErrors);
+
+#endif /* end of include guard: SPARSESOLVER_HPP_K3QX7TRM */
@@ -1,10 +1,30 @@
 #include <gtest/gtest.h>
 #include <yaml-cpp/yaml.h>
 #include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <filesystem>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
 
 #include "camera.hpp"
+#include "undistortlut.hpp"
+#include "residuals.hpp"
+#include "sparsesolver.hpp"
+#include "prefilter.hpp"
+#include "refine.hpp"
+#include "imagesource.hpp"
+#include "zhang.hpp"
+#include "detections.hpp"
+#include "circles.hpp"
+#include "utils.hpp"
 
 std::string calibFlagsNone = "CalibrationFlags: []\n";
 std::string pointFlagsNone = "PointFlags: []\n";
@@ -13,6 +33,57 @@ std::string geoDim = "PatternDimensions: 0.02635\n";
 std::string pType = "PointType: CHESS\n";
 std::string cType = "CalibrationType: REGULAR\n"; 
 
+// camera file as Camera::write produces it, 1920x1080 with mild distortion
+static YAML::Node testCameraNode()
+{
+	YAML::Node node;
+	node["Camera.name"] = "test";
+	node["Camera.fx"] = 1400.0;
+	node["Camera.fy"] = 1390.0;
+	node["Camera.cx"] = 962.5;
+	node["Camera.cy"] = 538.0;
+	for(const std::string k : {"k1", "k2", "p1", "p2", "k3", "k4", "k5", "k6",
+			"s1", "s2", "s3", "s4", "taox", "taoy"}){
+		node["Camera." + k] = 0.0;
+	}
+	node["Camera.k1"] = -0.12;
+	node["Camera.k2"] = 0.04;
+	node["Camera.p1"] = 0.0008;
+	node["Camera.p2"] = -0.0005;
+	node["Camera.widthPix"] = 1920.0;
+	node["Camera.heightPix"] = 1080.0;
+	node["Camera.sensorWidth"] = 13.2;
+	node["Camera.sensorHeight"] = 7.425;
+	return node;
+}
+
+// a 9x6 board of 3 cm squares seen from n tilted poses, projected with K and
+// dist plus gaussian pixel noise
+static void syntheticViews(const cv::Mat &K, const cv::Mat &dist, int n, double noise,
+		std::vector<vecp3f> &objectPoints, std::vector<vecp2f> &imagePoints)
+{
+	vecp3f board;
+	createKnownBoardDim(cv::Size(9, 6), 0.03f, board);
+
+	cv::RNG rng(42);
+	for(int i = 0; i < n; i++){
+		const cv::Vec3d rvec(0.35 * std::sin(1.7 * i), 0.35 * std::cos(1.3 * i),
+				0.2 * std::sin(0.7 * i));
+		const cv::Vec3d tvec(-0.12 + 0.04 * std::sin(2.1 * i), -0.075 + 0.03 * std::cos(1.1 * i),
+				0.55 + 0.02 * i);
+
+		vecp2f projected;
+		cv::projectPoints(board, rvec, tvec, K, dist, projected);
+		for(auto &p : projected){
+			p += cv::Point2f(static_cast<float>(rng.gaussian(noise)),
+					static_cast<float>(rng.gaussian(noise)));
+		}
+
+		objectPoints.push_back(board);
+		imagePoints.push_back(projected);
+	}
+}
+
 TEST(calibrationConfig, regular){
 
 
@@ -156,6 +227,611 @@ TEST(CalibrationConfig, pointFlagsCircle2){
 	EXPECT_FALSE(cc.pflags() & cv::CALIB_CB_CLUSTERING);
 
 }
+TEST(UndistortLUT, errorAgainstExact){
+
+	const Camera cam(testCameraNode());
+	auto lut = UndistortLUT::build(cam, cv::Size(1920, 1080), 8);
+
+	EXPECT_GT(lut->maxError(), 0.0);
+	EXPECT_LT(lut->maxError(), 0.05);
+	EXPECT_LE(lut->meanError(), lut->maxError());
+
+	vecp2f points;
+	cv::RNG rng(7);
+	for(int i = 0; i < 500; i++){
+		points.push_back(cv::Point2f(rng.uniform(0.0f, 1919.0f), rng.uniform(0.0f, 1079.0f)));
+	}
+
+	const vecp2f exact = cam.undistortPoints(points);
+	vecp2f approx;
+	lut->undistortPoints(points, approx);
+
+	ASSERT_EQ(approx.size(), exact.size());
+	for(size_t i = 0; i < exact.size(); i++){
+		// the bound is measured at cell centres, where bilinear error peaks
+		EXPECT_LT(cv::norm(approx[i] - exact[i]), 2.0 * lut->maxError() + 1e-3);
+	}
+
+}
+
+TEST(SparseSolver, agreesWithCalibrateCamera){
+
+	const Camera truth(testCameraNode());
+	std::vector<vecp3f> obj;
+	std::vector<vecp2f> img;
+	syntheticViews(truth.getIntrinsics(), truth.getDistortionParams(), 20, 0.1, obj, img);
+
+	const cv::Size size(1920, 1080);
+	const cv::TermCriteria crit(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, 100, 1e-10);
+
+	cv::Mat Kcv, distCv, stdIntCv, stdExtCv, errCv;
+	std::vector<cv::Mat> rCv, tCv;
+	const double rmsCv = cv::calibrateCamera(obj, img, size, Kcv, distCv, rCv, tCv,
+			stdIntCv, stdExtCv, errCv, 0, crit);
+
+	cv::Mat Ks, distS, stdIntS, stdExtS, errS;
+	std::vector<cv::Mat> rS, tS;
+	const double rmsS = calibrateCameraSparse(obj, img, size, Ks, distS, rS, tS,
+			stdIntS, stdExtS, errS, 0, crit);
+
+	EXPECT_NEAR(rmsS, rmsCv, 1e-3);
+	EXPECT_NEAR(Ks.at<double>(0,0), Kcv.at<double>(0,0), 0.5);
+	EXPECT_NEAR(Ks.at<double>(1,1), Kcv.at<double>(1,1), 0.5);
+	EXPECT_NEAR(Ks.at<double>(0,2), Kcv.at<double>(0,2), 0.5);
+	EXPECT_NEAR(Ks.at<double>(1,2), Kcv.at<double>(1,2), 0.5);
+	EXPECT_NEAR(distS.at<double>(0), distCv.at<double>(0), 1e-3);
+	EXPECT_NEAR(distS.at<double>(1), distCv.at<double>(1), 1e-2);
+
+	ASSERT_EQ(errS.total(), errCv.total());
+	for(size_t v = 0; v < errS.total(); v++){
+		EXPECT_NEAR(errS.at<double>(static_cast<int>(v)), errCv.at<double>(static_cast<int>(v)), 1e-3);
+	}
+
+	// both close to the truth for 0.1 px noise
+	EXPECT_NEAR(Ks.at<double>(0,0), 1400.0, 5.0);
+	EXPECT_NEAR(Ks.at<double>(1,1), 1390.0, 5.0);
+
+}
+
+TEST(Residuals, agreeWithCalibrationRms){
+
+	const Camera truth(testCameraNode());
+	std::vector<vecp3f> obj;
+	std::vector<vecp2f> img;
+	syntheticViews(truth.getIntrinsics(), truth.getDistortionParams(), 15, 0.2, obj, img);
+
+	CalibrationConfig conf(YAML::Load(
+			calibFlagsNone +
+			pointFlagsNone +
+			"PatternSize: [9, 6]\n"
+			"PatternDimensions: 0.03\n" +
+			pType +
+			cType
+			));
+
+	Camera cam("residuals");
+	cam.setPixWidth(1920);
+	cam.setPixHeight(1080);
+	const double rms = cam.calibrate(obj, img, conf);
+
+	Residuals res;
+	cam.evaluateResiduals(obj, img, res);
+
+	ASSERT_EQ(res.views(), obj.size());
+	ASSERT_EQ(res.corners(), obj.size() * 54);
+	EXPECT_NEAR(res.rms, rms, 1e-5);
+
+	// the csv holds every corner, its errors sum up to the same rms
+	const std::string csvPath =
+		(std::filesystem::temp_directory_path() / "camtests_residuals.csv").string();
+	ASSERT_TRUE(res.writeCsv(csvPath));
+
+	std::ifstream csv(csvPath);
+	std::string line;
+	std::getline(csv, line);
+	EXPECT_EQ(line, "view,corner,dx,dy,error");
+
+	size_t rows = 0;
+	double sq = 0.0, largest = 0.0;
+	while(std::getline(csv, line)){
+		std::replace(line.begin(), line.end(), ',', ' ');
+		std::istringstream fields(line);
+		size_t view, corner;
+		double dx, dy, error;
+		ASSERT_TRUE(static_cast<bool>(fields >> view >> corner >> dx >> dy >> error));
+		sq += error * error;
+		largest = std::max(largest, error);
+		rows++;
+	}
+	std::filesystem::remove(csvPath);
+
+	EXPECT_EQ(rows, res.corners());
+	EXPECT_NEAR(std::sqrt(sq / rows), rms, 1e-4);
+	EXPECT_NEAR(largest, res.maxError, 1e-4);
+
+	// and summary.json reports the same totals
+	const YAML::Node json = YAML::Load(res.toJson());
+	EXPECT_NEAR(json["rms"].as<double>(), rms, 1e-4);
+	EXPECT_NEAR(json["max_error"].as<double>(), res.maxError, 1e-4);
+
+}
+
+TEST(DuplicateFilter, hashDistance){
+
+	// smooth random texture, the hash only looks at low frequencies
+	cv::Mat noise(480, 640, CV_8UC1), texture;
+	cv::randu(noise, cv::Scalar(0), cv::Scalar(256));
+	cv::GaussianBlur(noise, texture, cv::Size(0, 0), 20.0);
+	cv::normalize(texture, texture, 0, 255, cv::NORM_MINMAX);
+
+	const cv::Mat frame = texture(cv::Rect(0, 0, 620, 460));
+	const cv::Mat shifted = texture(cv::Rect(2, 1, 620, 460));
+	cv::Mat mirrored;
+	cv::flip(frame, mirrored, 1);
+
+	cv::Mat thumb, freq;
+	const uint64_t h = DuplicateFilter::hash(frame, thumb, freq);
+
+	EXPECT_EQ(DuplicateFilter::distance(h, DuplicateFilter::hash(frame.clone(), thumb, freq)), 0);
+	EXPECT_LE(DuplicateFilter::distance(h, DuplicateFilter::hash(shifted, thumb, freq)), 4);
+	EXPECT_GT(DuplicateFilter::distance(h, DuplicateFilter::hash(mirrored, thumb, freq)), 10);
+
+	EXPECT_EQ(DuplicateFilter::distance(0, ~uint64_t(0)), 64);
+
+	// with the default threshold the shifted copy is dropped, the mirror kept
+	DuplicateFilter filter(YAML::Load("Enabled: true"));
+	EXPECT_TRUE(filter.accept(frame));
+	EXPECT_FALSE(filter.accept(shifted));
+	EXPECT_TRUE(filter.accept(mirrored));
+	EXPECT_EQ(filter.dropped(), 1);
+
+}
+
+TEST(Camera, deriveCropAndScale){
+
+	const Camera ref(testCameraNode());
+	const Camera mode = ref.derive("test_mode", cv::Rect2d(0.0, 135.0, 1920.0, 810.0),
+			cv::Size(960, 405));
+
+	const cv::Mat &K = mode.getIntrinsics();
+	EXPECT_DOUBLE_EQ(K.at<double>(0,0), 700.0);
+	EXPECT_DOUBLE_EQ(K.at<double>(1,1), 695.0);
+	// pixel centres: (c + 0.5 - offset) * scale - 0.5
+	EXPECT_DOUBLE_EQ(K.at<double>(0,2), 481.0);
+	EXPECT_DOUBLE_EQ(K.at<double>(1,2), 201.25);
+
+	EXPECT_EQ(mode.name(), "test_mode");
+	EXPECT_DOUBLE_EQ(mode.pixWidth(), 960.0);
+	EXPECT_DOUBLE_EQ(mode.pixHeight(), 405.0);
+	EXPECT_DOUBLE_EQ(mode.sensorWidth(), 13.2);
+	EXPECT_DOUBLE_EQ(mode.sensorHeight(), 7.425 * 810.0 / 1080.0);
+	EXPECT_EQ(cv::norm(mode.getDistortionParams(), ref.getDistortionParams()), 0.0);
+
+	// the derived model sees a point where the crop and scale put it
+	const vecp3f point{cv::Point3f(0.1f, 0.05f, 1.0f)};
+	const cv::Vec3d zero(0.0, 0.0, 0.0);
+	vecp2f inRef, inMode;
+	cv::projectPoints(point, zero, zero, ref.getIntrinsics(), ref.getDistortionParams(), inRef);
+	cv::projectPoints(point, zero, zero, K, mode.getDistortionParams(), inMode);
+
+	EXPECT_NEAR(inMode[0].x, (inRef[0].x + 0.5) * 0.5 - 0.5, 1e-3);
+	EXPECT_NEAR(inMode[0].y, (inRef[0].y + 0.5 - 135.0) * 0.5 - 0.5, 1e-3);
+
+}
+
+TEST(Camera, deriveDropsPerViewResults){
+
+	const Camera truth(testCameraNode());
+	std::vector<vecp3f> obj;
+	std::vector<vecp2f> img;
+	syntheticViews(truth.getIntrinsics(), truth.getDistortionParams(), 8, 0.2, obj, img);
+
+	CalibrationConfig conf(YAML::Load(
+			calibFlagsNone +
+			pointFlagsNone +
+			"PatternSize: [9, 6]\n"
+			"PatternDimensions: 0.03\n" +
+			pType +
+			cType
+			));
+
+	// fast, so the reference still holds the points for its uncertainties
+	Camera ref("reference");
+	ref.setPixWidth(1920);
+	ref.setPixHeight(1080);
+	ref.calibrate(obj, img, conf, 0, true);
+	ASSERT_EQ(ref.numberSamples(), 8);
+
+	Camera mode = ref.derive("test_mode", cv::Rect2d(0.0, 135.0, 1920.0, 810.0),
+			cv::Size(960, 405));
+	EXPECT_EQ(mode.numberSamples(), 0);
+	EXPECT_FALSE(mode.hasUncertainties());
+	EXPECT_TRUE(mode.getViewErrors().empty());
+	EXPECT_TRUE(mode.getStdDevIntrinsics().empty());
+
+	// nothing to linearize at, and the stats hold no views
+	EXPECT_NO_THROW(mode.computeUncertainties());
+	EXPECT_FALSE(mode.hasUncertainties());
+
+	const std::filesystem::path dir =
+		std::filesystem::temp_directory_path() / "camtests_derived_stats";
+	std::filesystem::create_directories(dir);
+	EXPECT_TRUE(mode.dumpStats(dir.string()));
+
+	std::ifstream log(dir / "log.csv");
+	std::string line;
+	size_t rows = 0;
+	while(std::getline(log, line)){
+		rows++;
+	}
+	EXPECT_EQ(rows, 1u);
+	std::filesystem::remove_all(dir);
+
+	// the reference keeps its own
+	ref.computeUncertainties();
+	EXPECT_TRUE(ref.hasUncertainties());
+	EXPECT_EQ(ref.getViewErrors().total(), 8u);
+
+}
+
+TEST(Camera, writeReadRoundTrip){
+
+	Camera cam(testCameraNode());
+
+	const std::filesystem::path dir =
+		std::filesystem::temp_directory_path() / "camtests_roundtrip";
+	std::filesystem::create_directories(dir);
+	ASSERT_TRUE(cam.write(dir.string()));
+
+	const Camera back(YAML::LoadFile((dir / "test.yml").string()));
+	std::filesystem::remove_all(dir);
+
+	EXPECT_EQ(back.name(), cam.name());
+	EXPECT_TRUE(back.isCalibrated());
+	EXPECT_LT(cv::norm(back.getIntrinsics(), cam.getIntrinsics()), 1e-9);
+	EXPECT_LT(cv::norm(back.getDistortionParams(), cam.getDistortionParams()), 1e-9);
+	EXPECT_DOUBLE_EQ(back.pixWidth(), 1920.0);
+	EXPECT_DOUBLE_EQ(back.pixHeight(), 1080.0);
+	EXPECT_DOUBLE_EQ(back.sensorWidth(), 13.2);
+	EXPECT_DOUBLE_EQ(back.sensorHeight(), 7.425);
+
+}
+
+TEST(CornerRefiner, parallelMatchesSerial){
+
+	// 10x7 squares of 40 px, 9x6 inner corners on pixel edges
+	const int side = 40;
+	const cv::Point origin(100, 80);
+	cv::Mat board(480, 640, CV_8UC1, cv::Scalar(255));
+	for(int r = 0; r < 7; r++){
+		for(int c = 0; c < 10; c++){
+			if((r + c) % 2 == 0){
+				cv::rectangle(board, cv::Rect(origin.x + c * side, origin.y + r * side, side, side),
+						cv::Scalar(0), cv::FILLED);
+			}
+		}
+	}
+	cv::GaussianBlur(board, board, cv::Size(0, 0), 1.5);
+
+	vecp2f truth, start;
+	for(int r = 1; r < 7; r++){
+		for(int c = 1; c < 10; c++){
+			const cv::Point2f corner(origin.x + c * side - 0.5f, origin.y + r * side - 0.5f);
+			truth.push_back(corner);
+			start.push_back(corner + cv::Point2f(1.3f, -0.8f));
+		}
+	}
+
+	// tiny chunks so the corners are spread over every thread
+	CalibrationConfig conf(YAML::Load(
+			calibFlagsNone +
+			pointFlagsNone +
+			"PatternSize: [9, 6]\n"
+			"PatternDimensions: 0.03\n" +
+			pType +
+			cType
+			));
+	const CornerRefiner refiner(YAML::Load("MinCornersPerThread: 4"), conf);
+
+	const cv::Size win = refiner.halfWindow(start);
+	EXPECT_EQ(win, cv::Size(14, 14)); // 0.35 of 40 px
+
+	vecp2f serial = start;
+	cv::cornerSubPix(board, serial, win, cv::Size(-1, -1),
+			cv::TermCriteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, 30, 0.001));
+
+	vecp2f parallel = start;
+	ASSERT_TRUE(refiner.refine(board, parallel));
+
+	ASSERT_EQ(parallel.size(), serial.size());
+	for(size_t k = 0; k < serial.size(); k++){
+		EXPECT_FLOAT_EQ(parallel[k].x, serial[k].x);
+		EXPECT_FLOAT_EQ(parallel[k].y, serial[k].y);
+		EXPECT_LT(cv::norm(parallel[k] - truth[k]), 0.1);
+	}
+
+}
+
+TEST(ShmRingSource, readsTheRing){
+
+	const std::string name = "/camtests_ring_" + std::to_string(getpid());
+	const int width = 64, height = 48, slots = 3;
+	const size_t frameBytes = width * height;
+	const size_t bytes = ShmRingHeader::dataOffset + slots * frameBytes;
+
+	const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(ftruncate(fd, bytes), 0);
+	void *mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	ASSERT_NE(mapping, MAP_FAILED);
+
+	ShmRingHeader *header = new (mapping) ShmRingHeader();
+	uint8_t *data = static_cast<uint8_t *>(mapping) + ShmRingHeader::dataOffset;
+	header->magic = ShmRingHeader::MAGIC;
+	header->width = width;
+	header->height = height;
+	header->slots = slots;
+
+	// five frames through three slots, only the last three are left
+	for(int n = 0; n < 5; n++){
+		std::fill(data + (n % slots) * frameBytes, data + (n % slots + 1) * frameBytes,
+				static_cast<uint8_t>(n + 1));
+	}
+	header->written = 5;
+	header->closed = 1;
+
+	EXPECT_THROW(ShmRingSource(name, width + 1, height), std::runtime_error);
+
+	{
+		ShmRingSource source(name, width, height);
+		Frame frame;
+		for(int n = 2; n < 5; n++){
+			ASSERT_TRUE(source.next(frame));
+			EXPECT_EQ(frame.index, static_cast<size_t>(n));
+			EXPECT_EQ(frame.image.size(), cv::Size(width, height));
+			double lo, hi;
+			cv::minMaxLoc(frame.image, &lo, &hi);
+			EXPECT_EQ(lo, n + 1);
+			EXPECT_EQ(hi, n + 1);
+		}
+		EXPECT_FALSE(source.next(frame));
+	}
+	// a closed reader gives every slot back to the producer
+	EXPECT_EQ(header->consumed.load(), 5u);
+
+	header->magic = 0;
+	EXPECT_THROW(ShmRingSource(name, width, height), std::runtime_error);
+
+	munmap(mapping, bytes);
+	shm_unlink(name.c_str());
+
+}
+
+TEST(Zhang, recoversIntrinsics){
+
+	const Camera truth(testCameraNode());
+	const cv::Mat noDist = cv::Mat::zeros(5, 1, CV_64F);
+	std::vector<vecp3f> obj;
+	std::vector<vecp2f> img;
+	syntheticViews(truth.getIntrinsics(), noDist, 12, 0.0, obj, img);
+
+	ZhangEstimate est;
+	ASSERT_TRUE(zhangInitialize(obj, img, cv::Size(1920, 1080), 0, est));
+
+	ASSERT_EQ(est.homographies.size(), obj.size());
+	ASSERT_EQ(est.rvecs.size(), obj.size());
+	ASSERT_EQ(est.tvecs.size(), obj.size());
+
+	// exact homographies, only float rounding of the image points remains
+	EXPECT_NEAR(est.K.at<double>(0,0), 1400.0, 1.0);
+	EXPECT_NEAR(est.K.at<double>(1,1), 1390.0, 1.0);
+	EXPECT_NEAR(est.K.at<double>(0,2), 962.5, 1.0);
+	EXPECT_NEAR(est.K.at<double>(1,2), 538.0, 1.0);
+	EXPECT_DOUBLE_EQ(est.K.at<double>(0,1), 0.0);
+
+	// the poses reproject the board onto the observations
+	for(size_t v = 0; v < obj.size(); v++){
+		vecp2f projected;
+		cv::projectPoints(obj[v], est.rvecs[v], est.tvecs[v], est.K, noDist, projected);
+		for(size_t k = 0; k < projected.size(); k++){
+			EXPECT_LT(cv::norm(projected[k] - img[v][k]), 1.0);
+		}
+	}
+
+}
+
+TEST(Camera, fastCalibrationUncertainties){
+
+	const Camera truth(testCameraNode());
+	std::vector<vecp3f> obj;
+	std::vector<vecp2f> img;
+	syntheticViews(truth.getIntrinsics(), truth.getDistortionParams(), 15, 0.2, obj, img);
+
+	CalibrationConfig conf(YAML::Load(
+			calibFlagsNone +
+			pointFlagsNone +
+			"PatternSize: [9, 6]\n"
+			"PatternDimensions: 0.03\n" +
+			pType +
+			cType
+			));
+
+	Camera full("full");
+	full.setPixWidth(1920);
+	full.setPixHeight(1080);
+	const double rmsFull = full.calibrate(obj, img, conf);
+	ASSERT_TRUE(full.hasUncertainties());
+
+	Camera fast("fast");
+	fast.setPixWidth(1920);
+	fast.setPixHeight(1080);
+	const double rmsFast = fast.calibrate(obj, img, conf, 0, true);
+	EXPECT_NEAR(rmsFast, rmsFull, 1e-6);
+	EXPECT_FALSE(fast.hasUncertainties());
+	EXPECT_TRUE(fast.getViewErrors().empty());
+
+	// one linearization at the solution gives what calibrateCamera reports
+	fast.computeUncertainties();
+	ASSERT_TRUE(fast.hasUncertainties());
+
+	const cv::Mat &sFast = fast.getStdDevIntrinsics();
+	const cv::Mat &sFull = full.getStdDevIntrinsics();
+	ASSERT_GE(sFast.total(), 9u);
+	ASSERT_GE(sFull.total(), 9u);
+
+	// calibrateCamera divides the squared error by points - parameters up
+	// to OpenCV 4 and by residuals - parameters from 5 on, so the two agree
+	// up to that one factor
+	const double points = 54.0 * obj.size();
+	const double params = 9.0 + 6.0 * obj.size();
+	const double dof = std::sqrt((2.0 * points - params) / (points - params));
+	const double scale = sFast.at<double>(0) / sFull.at<double>(0);
+	EXPECT_TRUE(std::abs(scale - 1.0) < 0.01 || std::abs(scale * dof - 1.0) < 0.01)
+		<< "scale " << scale;
+
+	// fx fy cx cy k1 k2 p1 p2 k3
+	for(int k = 0; k < 9; k++){
+		const double ref = scale * sFull.at<double>(k);
+		EXPECT_GT(ref, 0.0);
+		EXPECT_NEAR(sFast.at<double>(k), ref, 0.01 * ref) << "parameter " << k;
+	}
+
+	ASSERT_EQ(fast.getViewErrors().total(), full.getViewErrors().total());
+	for(int v = 0; v < static_cast<int>(obj.size()); v++){
+		EXPECT_NEAR(fast.getViewErrors().at<double>(v), full.getViewErrors().at<double>(v), 1e-4);
+	}
+
+}
+
+static vecp2f cornersFor(int index, int count = 12)
+{
+	vecp2f corners;
+	for(int k = 0; k < count; k++){
+		corners.push_back(cv::Point2f(index * 10.0f + k, index + 0.25f * k));
+	}
+	return corners;
+}
+
+static DetectionSet shardOf(int shardIndex, int frames, const std::vector<int> &found,
+		cv::Size pattern = cv::Size(4, 3))
+{
+	DetectionSet set;
+	set.imageSize = cv::Size(1920, 1080);
+	set.patternSize = pattern;
+	set.squareSize = 0.03;
+	set.shardIndex = shardIndex;
+	set.shardCount = 3;
+	set.framesProcessed = frames;
+	for(int index : found){
+		set.add(index, "frame_" + std::to_string(index) + ".png", cornersFor(index, pattern.area()));
+	}
+	return set;
+}
+
+TEST(DetectionSet, writeReadMerge){
+
+	const std::filesystem::path dir =
+		std::filesystem::temp_directory_path() / "camtests_detections";
+	std::filesystem::create_directories(dir);
+	const std::string p0 = (dir / "detections_0_of_3.yml.gz").string();
+	const std::string p1 = (dir / "detections_1_of_3.yml.gz").string();
+	const std::string p2 = (dir / "detections_2_of_3.yml.gz").string();
+
+	shardOf(0, 3, {0, 1}).write(p0);
+	shardOf(1, 3, {3, 5}).write(p1);
+	shardOf(2, 2, {7}).write(p2);
+
+	const DetectionSet one = DetectionSet::read(p1);
+	EXPECT_EQ(one.imageSize, cv::Size(1920, 1080));
+	EXPECT_EQ(one.patternSize, cv::Size(4, 3));
+	EXPECT_DOUBLE_EQ(one.squareSize, 0.03);
+	EXPECT_EQ(one.shardIndex, 1);
+	EXPECT_EQ(one.shardCount, 3);
+	EXPECT_EQ(one.framesProcessed, 3);
+	ASSERT_EQ(one.views(), 2u);
+	EXPECT_EQ(one.indices, std::vector<int>({3, 5}));
+	EXPECT_EQ(one.labels[1], "frame_5.png");
+	EXPECT_EQ(one.corners[1], cornersFor(5));
+
+	// shards given out of order come back in input order
+	const DetectionSet merged = DetectionSet::merge({p2, p0, p1});
+	EXPECT_EQ(merged.framesProcessed, 8);
+	ASSERT_EQ(merged.views(), 5u);
+	EXPECT_EQ(merged.indices, std::vector<int>({0, 1, 3, 5, 7}));
+	for(size_t v = 0; v < merged.views(); v++){
+		EXPECT_EQ(merged.labels[v], "frame_" + std::to_string(merged.indices[v]) + ".png");
+		EXPECT_EQ(merged.corners[v], cornersFor(merged.indices[v]));
+	}
+
+	// the same shard twice, or a shard of another board, is refused
+	EXPECT_THROW(DetectionSet::merge({p0, p0}), std::runtime_error);
+	shardOf(2, 2, {7}, cv::Size(9, 6)).write(p2);
+	EXPECT_THROW(DetectionSet::merge({p0, p2}), std::runtime_error);
+
+	// a view that doesn't match the pattern is not written at all
+	DetectionSet shortRow = shardOf(0, 1, {0});
+	shortRow.corners[0].pop_back();
+	const std::string p3 = (dir / "short.yml.gz").string();
+	EXPECT_THROW(shortRow.write(p3), std::runtime_error);
+	EXPECT_FALSE(std::filesystem::exists(p3));
+
+	std::filesystem::remove_all(dir);
+
+}
+
+// mean and largest distance from each centre to the nearest true centre
+static void centerErrors(const vecp2f &found, const vecp2f &truth, double &mean, double &largest)
+{
+	mean = 0.0;
+	largest = 0.0;
+	for(const auto &p : found){
+		double best = std::numeric_limits<double>::max();
+		for(const auto &t : truth){
+			best = std::min(best, cv::norm(p - t));
+		}
+		mean += best;
+		largest = std::max(largest, best);
+	}
+	mean /= found.size();
+}
+
+TEST(CircleGridDetector, downscaledAsAccurateAsFullSize){
+
+	// dark antialiased circles at sub-pixel centres on a large white frame
+	const cv::Size ps(7, 5);
+	cv::Mat image(1800, 2400, CV_8UC1, cv::Scalar(255));
+	vecp2f truth;
+	for(int r = 0; r < ps.height; r++){
+		for(int c = 0; c < ps.width; c++){
+			const cv::Point2f centre(700.3f + 120.25f * c, 600.7f + 120.25f * r);
+			truth.push_back(centre);
+			cv::circle(image, cv::Point(static_cast<int>(std::lround(centre.x * 16)),
+						static_cast<int>(std::lround(centre.y * 16))),
+					30 * 16, cv::Scalar(0), cv::FILLED, cv::LINE_AA, 4);
+		}
+	}
+
+	vecp2f full;
+	ASSERT_TRUE(cv::findCirclesGrid(image, ps, full, cv::CALIB_CB_SYMMETRIC_GRID));
+	ASSERT_EQ(full.size(), truth.size());
+
+	const CircleGridDetector detector(YAML::Load("MaxSide: 800"), ps,
+			cv::CALIB_CB_SYMMETRIC_GRID);
+	vecp2f refined;
+	ASSERT_TRUE(detector.detect(image, refined));
+	ASSERT_EQ(refined.size(), truth.size());
+
+	double fullMean, fullMax, refinedMean, refinedMax;
+	centerErrors(full, truth, fullMean, fullMax);
+	centerErrors(refined, truth, refinedMean, refinedMax);
+
+	EXPECT_LT(refinedMean, 0.1);
+	EXPECT_LT(refinedMax, 0.25);
+	EXPECT_LE(refinedMean, fullMean + 0.05);
+
+}
+
 int main(int argc, char *argv[]){
 	testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
@@ -0,0 +1,175 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "thumbnails.hpp"
+
+namespace fs = std::filesystem;
+
+static std::string escapeHtml(const std::string &text)
+{
+	std::string out;
+	for(char c : text){
+		switch(c){
+			case '&': out += "&amp;"; break;
+			case '<': out += "&lt;"; break;
+			case '>': out += "&gt;"; break;
+			case '"': out += "&quot;"; break;
+			default: out += c;
+		}
+	}
+	return out;
+}
+
+ThumbnailWriter::ThumbnailWriter(const std::string &outputDir, int side, size_t queueDepth):
+	dir(outputDir + "/thumbs"),
+	maxSide(side),
+	jobs(queueDepth),
+	finished(false),
+	dropped_(0)
+{
+	if(maxSide < 16){
+		throw std::runtime_error("Thumbnails need a side of at least 16 pixels!\n");
+	}
+	fs::create_directories(dir);
+	worker = std::thread(&ThumbnailWriter::work, this);
+}
+
+ThumbnailWriter::~ThumbnailWriter()
+{
+	jobs.close();
+	if(worker.joinable()){
+		worker.join();
+	}
+}
+
+void ThumbnailWriter::submit(const cv::Mat &gray, const std::string &label,
+		cv::Size patternSize, const vecp2f &corners, double sharpness, int view)
+{
+	std::ostringstream name;
+	name << std::setw(6) << std::setfill('0') << entries.size() << ".jpg";
+
+	Entry entry{name.str(), fs::path(label).filename().string(), !corners.empty(),
+		sharpness, view};
+
+	const double scale = std::min(1.0,
+			static_cast<double>(maxSide) / std::max(gray.cols, gray.rows));
+
+	Job job;
+	// the frame buffer is recycled by the source, the thumbnail is a copy
+	cv::resize(gray, job.small, cv::Size(), scale, scale, cv::INTER_AREA);
+	job.file = dir + "/" + entry.file;
+	job.patternSize = patternSize;
+	job.corners.reserve(corners.size());
+	for(const auto &c : corners){
+		job.corners.push_back(c * scale);
+	}
+
+	std::ostringstream caption;
+	caption << entry.label;
+	if(entry.found){
+		caption << std::fixed << std::setprecision(2) << "  sharpness " << sharpness;
+	}
+	job.caption = caption.str();
+
+	if(!jobs.tryPush(std::move(job))){
+		entry.file.clear();
+		dropped_++;
+	}
+	entries.push_back(entry);
+}
+
+void ThumbnailWriter::work()
+{
+	Job job;
+	cv::Mat color;
+
+	while(jobs.pop(job)){
+		cv::cvtColor(job.small, color, cv::COLOR_GRAY2BGR);
+
+		if(!job.corners.empty()){
+			cv::drawChessboardCorners(color, job.patternSize, job.corners, true);
+		}
+		else{
+			cv::putText(color, "not found", cv::Point(8, color.rows / 2),
+					cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 255), 2);
+		}
+
+		cv::rectangle(color, cv::Rect(0, 0, color.cols, 18), cv::Scalar(0, 0, 0), cv::FILLED);
+		cv::putText(color, job.caption, cv::Point(4, 13),
+				cv::FONT_HERSHEY_SIMPLEX, 0.4, cv::Scalar(255, 255, 255), 1);
+
+		cv::imwrite(job.file, color);
+	}
+}
+
+void ThumbnailWriter::finish(const cv::Mat &viewErrors)
+{
+	if(finished){
+		return;
+	}
+	finished = true;
+
+	jobs.close();
+	worker.join();
+
+	// the errors are only known after calibration, long after the thumbnails
+	// were encoded; they go into the index instead of the pixels
+	std::ofstream html(dir + "/index.html");
+	std::ofstream csv(dir + "/views.csv");
+	if(!html.is_open() || !csv.is_open()){
+		throw std::runtime_error("Unable to write the thumbnail index to " + dir + "\n");
+	}
+
+	csv << "thumbnail,image,found,sharpness,view,error\n";
+	for(const auto &e : entries){
+		csv << e.file << ",\"" << e.label << "\"," << (e.found ? "true" : "false") << ','
+			<< e.sharpness << ',' << e.view << ',';
+		if(e.view >= 0 && e.view < viewErrors.rows){
+			csv << viewErrors.at<double>(e.view, 0);
+		}
+		csv << "\n";
+	}
+
+	html << "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Detections</title>\n"
+		<< "<style>body{font-family:sans-serif;background:#222;color:#ddd}"
+		<< "figure{display:inline-block;margin:4px;vertical-align:top}"
+		<< "figcaption{font-size:12px}.miss{color:#e66}.view{color:#6e6}</style>\n"
+		<< "</head><body>\n"
+		<< "<p>" << entries.size() << " frames, " << dropped_
+		<< " thumbnails dropped while detection was running</p>\n";
+
+	for(const auto &e : entries){
+		html << "<figure>";
+		if(!e.file.empty()){
+			html << "<a href=\"" << e.file << "\"><img src=\"" << e.file << "\"></a>";
+		}
+		html << "<figcaption>" << escapeHtml(e.label) << "<br>";
+
+		if(!e.found){
+			html << "<span class=\"miss\">not found</span>";
+		}
+		else{
+			html << "sharpness " << std::fixed << std::setprecision(2) << e.sharpness;
+			if(e.view >= 0 && e.view < viewErrors.rows){
+				html << "<br><span class=\"view\">view " << e.view << ", error "
+					<< std::setprecision(3) << viewErrors.at<double>(e.view, 0) << " px</span>";
+			}
+			else if(e.view < 0){
+				html << "<br>not used";
+			}
+		}
+		html << "</figcaption></figure>\n";
+	}
+
+	html << "</body></html>\n";
+}
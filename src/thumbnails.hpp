@@ -0,0 +1,78 @@
+#ifndef THUMBNAILS_HPP_T5GJ2WXR
+#define THUMBNAILS_HPP_T5GJ2WXR
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <opencv2/core.hpp>
+
+#include "camera.hpp"
+#include "queue.hpp"
+
+/*
+ * Annotated, downscaled copies of the processed frames for reviewing a run
+ * afterwards instead of in the blocking review window. The caller only
+ * downscales; drawing, encoding and writing happen on a background thread.
+ * When the writer falls behind thumbnails are dropped, detection never
+ * waits. Every thumbnail is encoded once. finish() writes
+ * <dir>/thumbs/index.html, a contact sheet with the per-view reprojection
+ * error of the calibration next to every thumbnail, and the same list as
+ * <dir>/thumbs/views.csv.
+ */
+class ThumbnailWriter {
+	public:
+		ThumbnailWriter() = delete;
+
+		ThumbnailWriter(const std::string &outputDir, int maxSide, size_t queueDepth);
+
+		ThumbnailWriter(const ThumbnailWriter &other) = delete;
+		ThumbnailWriter &operator=(const ThumbnailWriter &other) = delete;
+
+		~ThumbnailWriter();
+
+		// corners empty if the board was not found, view is the index of the
+		// calibration view the detection became or -1
+		void submit(const cv::Mat &gray, const std::string &label,
+				cv::Size patternSize, const vecp2f &corners,
+				double sharpness, int view);
+
+		// waits for the queued thumbnails and writes the index, viewErrors
+		// as returned by Camera::getViewErrors, may be empty
+		void finish(const cv::Mat &viewErrors);
+
+		size_t written() const {return entries.size() - dropped_;}
+		size_t dropped() const {return dropped_;}
+
+	private:
+
+		struct Job {
+			cv::Mat small;
+			std::string file;
+			std::string caption;
+			cv::Size patternSize;
+			vecp2f corners; // in thumbnail pixels
+		};
+
+		struct Entry {
+			std::string file;
+			std::string label;
+			bool found;
+			double sharpness;
+			int view;
+		};
+
+		void work();
+
+		std::string dir;
+		int maxSide;
+
+		BoundedQueue<Job> jobs;
+		std::thread worker;
+		bool finished;
+
+		std::vector<Entry> entries;
+		size_t dropped_;
+};
+
+#endif /* end of include guard: THUMBNAILS_HPP_T5GJ2WXR */
@@ -0,0 +1,91 @@
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "undistortlut.hpp"
+
+std::shared_ptr<const UndistortLUT> UndistortLUT::build(const Camera &cam,
+		cv::Size imageSize, int step)
+{
+	return std::shared_ptr<const UndistortLUT>(new UndistortLUT(cam, imageSize, step));
+}
+
+UndistortLUT::UndistortLUT(const Camera &cam, cv::Size imageSize, int step):
+	imageSize_(imageSize),
+	step_(step),
+	maxError_(0.0),
+	meanError_(0.0)
+{
+	if(step <= 0 || imageSize.width <= 0 || imageSize.height <= 0){
+		throw std::runtime_error("Lookup table needs a positive step and image size!\n");
+	}
+
+	const cv::Mat &K = cam.getIntrinsics();
+	const cv::Mat &dist = cam.getDistortionParams();
+
+	fx = K.at<double>(0,0);
+	fy = K.at<double>(1,1);
+	cx = K.at<double>(0,2);
+	cy = K.at<double>(1,2);
+
+	invStep = 1.0f / step;
+	// one extra node so the last pixel always has a cell to interpolate in
+	cols = (imageSize.width - 1) / step + 2;
+	rows = (imageSize.height - 1) / step + 2;
+	table.resize(cols * rows);
+
+	cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range &range){
+		vecp2f nodes(cols), undist;
+		for(int j = range.start; j < range.end; j++){
+			for(int i = 0; i < cols; i++){
+				nodes[i] = cv::Point2f(i * step, j * step);
+			}
+			cv::undistortPoints(nodes, undist, K, dist);
+			std::copy(undist.begin(), undist.end(), table.begin() + j * cols);
+		}
+	});
+
+	measureError(K, dist);
+}
+
+void UndistortLUT::measureError(const cv::Mat &K, const cv::Mat &dist)
+{
+	const int cellCols = cols - 1;
+	const int cellRows = rows - 1;
+	std::vector<double> rowMax(cellRows, 0.0), rowSum(cellRows, 0.0);
+
+	cv::parallel_for_(cv::Range(0, cellRows), [&](const cv::Range &range){
+		vecp2f centres(cellCols), exact;
+		for(int j = range.start; j < range.end; j++){
+			for(int i = 0; i < cellCols; i++){
+				centres[i] = cv::Point2f((i + 0.5f) * step_, (j + 0.5f) * step_);
+			}
+			cv::undistortPoints(centres, exact, K, dist);
+
+			for(int i = 0; i < cellCols; i++){
+				const cv::Point2f n = normalized(centres[i]);
+				const double e = std::hypot(fx * (n.x - exact[i].x), fy * (n.y - exact[i].y));
+				rowMax[j] = std::max(rowMax[j], e);
+				rowSum[j] += e;
+			}
+		}
+	});
+
+	for(int j = 0; j < cellRows; j++){
+		maxError_ = std::max(maxError_, rowMax[j]);
+		meanError_ += rowSum[j];
+	}
+	meanError_ /= static_cast<double>(cellRows) * cellCols;
+}
+
+void UndistortLUT::undistortPoints(const vecp2f &input, vecp2f &output) const
+{
+	output.resize(input.size());
+	for(size_t i = 0; i < input.size(); i++){
+		output[i] = undistort(input[i]);
+	}
+}
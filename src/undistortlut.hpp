@@ -0,0 +1,91 @@
+#ifndef UNDISTORTLUT_HPP_A8FJ2WQN
+#define UNDISTORTLUT_HPP_A8FJ2WQN
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core.hpp>
+
+#include "camera.hpp"
+
+/*
+ * Precomputed grid of undistorted normalized coordinates, one node every
+ * `step` pixels over the image. Point queries are a bilinear interpolation
+ * instead of the iterative inversion in cv::undistortPoints.
+ *
+ * Immutable once built, share the same table between threads through the
+ * shared_ptr returned by build(). Queries are meant for points inside the
+ * image, outside it the border cells are extrapolated.
+ */
+class UndistortLUT {
+	public:
+		UndistortLUT() = delete;
+		UndistortLUT(const UndistortLUT &other) = delete;
+		UndistortLUT &operator=(const UndistortLUT &other) = delete;
+
+		static std::shared_ptr<const UndistortLUT> build(const Camera &cam,
+				cv::Size imageSize, int step);
+
+		// undistorted point on the z = 1 plane
+		cv::Point2f normalized(cv::Point2f p) const
+		{
+			const float gx = p.x * invStep;
+			const float gy = p.y * invStep;
+			const int ix = std::clamp(static_cast<int>(gx), 0, cols - 2);
+			const int iy = std::clamp(static_cast<int>(gy), 0, rows - 2);
+			const float ax = gx - ix;
+			const float ay = gy - iy;
+
+			const cv::Point2f *r0 = &table[iy * cols + ix];
+			const cv::Point2f *r1 = r0 + cols;
+
+			return (r0[0] * (1.0f - ax) + r0[1] * ax) * (1.0f - ay)
+				+ (r1[0] * (1.0f - ax) + r1[1] * ax) * ay;
+		}
+
+		// unit bearing vector in camera coordinates
+		cv::Vec3f bearing(cv::Point2f p) const
+		{
+			const cv::Point2f n = normalized(p);
+			const float inv = 1.0f / std::sqrt(n.x * n.x + n.y * n.y + 1.0f);
+			return cv::Vec3f(n.x * inv, n.y * inv, inv);
+		}
+
+		// undistorted pixel coordinates, same camera matrix as the input
+		cv::Point2f undistort(cv::Point2f p) const
+		{
+			const cv::Point2f n = normalized(p);
+			return cv::Point2f(fx * n.x + cx, fy * n.y + cy);
+		}
+
+		void undistortPoints(const vecp2f &input, vecp2f &output) const;
+
+		int step() const {return step_;}
+		cv::Size imageSize() const {return imageSize_;}
+
+		// interpolation error in pixels against the exact inversion,
+		// measured at every cell centre when the table is built
+		double maxError() const {return maxError_;}
+		double meanError() const {return meanError_;}
+
+	private:
+
+		UndistortLUT(const Camera &cam, cv::Size imageSize, int step);
+
+		void measureError(const cv::Mat &K, const cv::Mat &dist);
+
+		cv::Size imageSize_;
+		int step_;
+		float invStep;
+		int cols;
+		int rows;
+		float fx, fy, cx, cy;
+		std::vector<cv::Point2f> table;
+
+		double maxError_;
+		double meanError_;
+};
+
+#endif /* end of include guard: UNDISTORTLUT_HPP_A8FJ2WQN */
@@ -1,7 +1,21 @@
 #ifndef UTILS_HPP_NPVQH3EA
 #define UTILS_HPP_NPVQH3EA
 
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
 void createKnownBoardDim(cv::Size brdSize, 
 		float sqrEdgeLength, std::vector<cv::Point3f> &corners);
 
+// value of an optional yml key, fallback if the node or key is missing
+template<typename T>
+T valueOr(const YAML::Node &node, const std::string &key, const T &fallback)
+{
+	if(node.IsDefined() && node.IsMap() && node[key]){
+		return node[key].as<T>();
+	}
+	return fallback;
+}
+
 #endif /* end of include guard: UTILS_HPP_NPVQH3EA */
@@ -0,0 +1,225 @@
+#include <vector>
+#include <cmath>
+
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+#include "zhang.hpp"
+
+namespace {
+
+// row of the constraint hi^T B hj = v_ij^T b, b = [B11 B12 B22 B13 B23 B33]
+void constraintRow(const cv::Matx33d &H, int i, int j, double *v)
+{
+	v[0] = H(0,i) * H(0,j);
+	v[1] = H(0,i) * H(1,j) + H(1,i) * H(0,j);
+	v[2] = H(1,i) * H(1,j);
+	v[3] = H(2,i) * H(0,j) + H(0,i) * H(2,j);
+	v[4] = H(2,i) * H(1,j) + H(1,i) * H(2,j);
+	v[5] = H(2,i) * H(2,j);
+}
+
+// full zero skew solution, false if B is not positive definite
+bool solveFull(const std::vector<cv::Matx33d> &Hs, cv::Matx33d &K)
+{
+	cv::Mat V = cv::Mat::zeros(2 * static_cast<int>(Hs.size()) + 1, 6, CV_64F);
+
+	for(size_t k = 0; k < Hs.size(); k++){
+		double v11[6], v12[6], v22[6];
+		constraintRow(Hs[k], 0, 1, v12);
+		constraintRow(Hs[k], 0, 0, v11);
+		constraintRow(Hs[k], 1, 1, v22);
+
+		for(int c = 0; c < 6; c++){
+			V.at<double>(2 * k, c) = v12[c];
+			V.at<double>(2 * k + 1, c) = v11[c] - v22[c];
+		}
+	}
+	// zero skew, B12 = 0
+	V.at<double>(V.rows - 1, 1) = 1.0;
+
+	if(V.rows < 5){
+		return false;
+	}
+
+	cv::Mat w, u, vt;
+	cv::SVD::compute(V, w, u, vt, cv::SVD::FULL_UV);
+	const double *b = vt.ptr<double>(5);
+
+	double B11 = b[0], B12 = b[1], B22 = b[2], B13 = b[3], B23 = b[4], B33 = b[5];
+	if(B11 < 0.0){
+		B11 = -B11; B12 = -B12; B22 = -B22; B13 = -B13; B23 = -B23; B33 = -B33;
+	}
+
+	const double den = B11 * B22 - B12 * B12;
+	if(B11 <= 0.0 || den <= 0.0){
+		return false;
+	}
+
+	const double v0 = (B12 * B13 - B11 * B23) / den;
+	const double lambda = B33 - (B13 * B13 + v0 * (B12 * B13 - B11 * B23)) / B11;
+	if(lambda <= 0.0){
+		return false;
+	}
+
+	const double alpha = std::sqrt(lambda / B11);
+	const double beta = std::sqrt(lambda * B11 / den);
+	const double u0 = -B13 * alpha * alpha / lambda;
+
+	K = cv::Matx33d(alpha, 0.0, u0,
+			0.0, beta, v0,
+			0.0, 0.0, 1.0);
+	return true;
+}
+
+// focal lengths only, principal point given; cv::initCameraMatrix2D style
+bool solveFocal(const std::vector<cv::Matx33d> &Hs, cv::Point2d pp, cv::Matx33d &K)
+{
+	const cv::Matx33d Tinv(1.0, 0.0, -pp.x,
+			0.0, 1.0, -pp.y,
+			0.0, 0.0, 1.0);
+
+	// with the principal point removed B = diag(1/fx^2, 1/fy^2, .)
+	cv::Mat A(2 * static_cast<int>(Hs.size()), 2, CV_64F);
+	cv::Mat rhs(A.rows, 1, CV_64F);
+
+	for(size_t k = 0; k < Hs.size(); k++){
+		const cv::Matx33d H = Tinv * Hs[k];
+		A.at<double>(2 * k, 0) = H(0,0) * H(0,1);
+		A.at<double>(2 * k, 1) = H(1,0) * H(1,1);
+		rhs.at<double>(2 * k, 0) = -H(2,0) * H(2,1);
+		A.at<double>(2 * k + 1, 0) = H(0,0) * H(0,0) - H(0,1) * H(0,1);
+		A.at<double>(2 * k + 1, 1) = H(1,0) * H(1,0) - H(1,1) * H(1,1);
+		rhs.at<double>(2 * k + 1, 0) = -(H(2,0) * H(2,0) - H(2,1) * H(2,1));
+	}
+
+	cv::Mat f;
+	if(!cv::solve(A, rhs, f, cv::DECOMP_SVD)){
+		return false;
+	}
+
+	const double ix = f.at<double>(0,0);
+	const double iy = f.at<double>(1,0);
+	if(ix <= 0.0 || iy <= 0.0){
+		return false;
+	}
+
+	K = cv::Matx33d(1.0 / std::sqrt(ix), 0.0, pp.x,
+			0.0, 1.0 / std::sqrt(iy), pp.y,
+			0.0, 0.0, 1.0);
+	return true;
+}
+
+void pose(const cv::Matx33d &Kinv, const cv::Matx33d &H, cv::Mat &rvec, cv::Mat &tvec)
+{
+	const cv::Vec3d h1(H(0,0), H(1,0), H(2,0));
+	const cv::Vec3d h2(H(0,1), H(1,1), H(2,1));
+	const cv::Vec3d h3(H(0,2), H(1,2), H(2,2));
+
+	double scale = 1.0 / cv::norm(Kinv * h1);
+	cv::Vec3d t = scale * (Kinv * h3);
+	// the board is in front of the camera
+	if(t[2] < 0.0){
+		scale = -scale;
+		t = -t;
+	}
+
+	const cv::Vec3d r1 = scale * (Kinv * h1);
+	const cv::Vec3d r2 = scale * (Kinv * h2);
+	const cv::Vec3d r3 = r1.cross(r2);
+
+	cv::Matx33d R(r1[0], r2[0], r3[0],
+			r1[1], r2[1], r3[1],
+			r1[2], r2[2], r3[2]);
+
+	// closest rotation
+	cv::Mat w, u, vt;
+	cv::SVD::compute(cv::Mat(R), w, u, vt);
+	cv::Mat Rn = u * vt;
+
+	cv::Rodrigues(Rn, rvec);
+	tvec = cv::Mat(t).clone();
+}
+
+}
+
+bool zhangInitialize(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		cv::Size imageSize,
+		int flags,
+		ZhangEstimate &estimate)
+{
+	const int nViews = static_cast<int>(objectPoints.size());
+	if(nViews == 0 || imagePoints.size() != objectPoints.size()){
+		return false;
+	}
+
+	// pixels are normalized so the constraint matrix is well conditioned
+	const double s = 2.0 / (imageSize.width + imageSize.height);
+	const cv::Matx33d N(s, 0.0, -s * imageSize.width / 2.0,
+			0.0, s, -s * imageSize.height / 2.0,
+			0.0, 0.0, 1.0);
+
+	estimate.homographies.assign(nViews, cv::Mat());
+	std::vector<cv::Matx33d> Hs(nViews);
+	std::vector<char> valid(nViews, 0);
+
+	cv::parallel_for_(cv::Range(0, nViews), [&](const cv::Range &range){
+		std::vector<cv::Point2f> plane;
+		for(int i = range.start; i < range.end; i++){
+			plane.clear();
+			for(const auto &p : objectPoints[i]){
+				plane.emplace_back(p.x, p.y);
+			}
+
+			cv::Mat H = cv::findHomography(plane, imagePoints[i]);
+			if(H.empty()){
+				continue;
+			}
+			estimate.homographies[i] = H;
+			Hs[i] = N * cv::Matx33d(H);
+			valid[i] = 1;
+		}
+	});
+
+	std::vector<cv::Matx33d> good;
+	for(int i = 0; i < nViews; i++){
+		if(valid[i]){
+			good.push_back(Hs[i]);
+		}
+	}
+	if(good.empty()){
+		return false;
+	}
+
+	cv::Matx33d Kn;
+	const bool fixPP = flags & cv::CALIB_FIX_PRINCIPAL_POINT;
+	if(fixPP || !solveFull(good, Kn)){
+		// image centre is the origin of the normalized pixels
+		if(!solveFocal(good, cv::Point2d(0.0, 0.0), Kn)){
+			return false;
+		}
+	}
+
+	cv::Matx33d K = N.inv() * Kn;
+
+	if(flags & cv::CALIB_FIX_ASPECT_RATIO){
+		const double f = 0.5 * (K(0,0) + K(1,1));
+		K(0,0) = f;
+		K(1,1) = f;
+	}
+
+	estimate.K = cv::Mat(K).clone();
+	estimate.rvecs.assign(nViews, cv::Mat());
+	estimate.tvecs.assign(nViews, cv::Mat());
+
+	const cv::Matx33d Kinv = K.inv();
+	for(int i = 0; i < nViews; i++){
+		if(!valid[i]){
+			return false;
+		}
+		pose(Kinv, cv::Matx33d(estimate.homographies[i]), estimate.rvecs[i], estimate.tvecs[i]);
+	}
+
+	return true;
+}
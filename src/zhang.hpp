@@ -0,0 +1,33 @@
+#ifndef ZHANG_HPP_M2VQ8DLE
+#define ZHANG_HPP_M2VQ8DLE
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "camera.hpp"
+
+struct ZhangEstimate {
+	cv::Mat K;                       // 3x3, zero skew
+	std::vector<cv::Mat> rvecs;      // board to camera, one per view
+	std::vector<cv::Mat> tvecs;
+	std::vector<cv::Mat> homographies;
+};
+
+/*
+ * Closed form intrinsics and poses from planar boards (Zhang 2000), without
+ * distortion. Per-view homographies are fitted in parallel, then K follows
+ * from the linear constraints on the image of the absolute conic with zero
+ * skew imposed. CALIB_FIX_ASPECT_RATIO and CALIB_FIX_PRINCIPAL_POINT are
+ * honoured the way calibrateCamera starts (unit aspect, image centre).
+ * Falls back to the principal point at the image centre when the full
+ * solution is degenerate (too few or too similar views). Object points must
+ * lie in the z = 0 plane. Returns false if no estimate could be made.
+ */
+bool zhangInitialize(const std::vector<vecp3f> &objectPoints,
+		const std::vector<vecp2f> &imagePoints,
+		cv::Size imageSize,
+		int flags,
+		ZhangEstimate &estimate);
+
+#endif /* end of include guard: ZHANG_HPP_M2VQ8DLE */